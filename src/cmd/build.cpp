@@ -3,7 +3,9 @@
 #include "../core/context.h"
 #include "../core/ini.h"
 #include "../core/op.h"
+#include "../tasks/task.h"
 #include "../tasks/task_manager.h"
+#include "../tools/tools.h"
 #include "commands.h"
 
 namespace mob {
@@ -87,6 +89,15 @@ namespace mob {
                (clipp::option("--keep-msbuild") >> keep_msbuild_) %
                    "don't terminate msbuild.exe instances after building",
 
+               (clipp::repeatable(clipp::option("--affected-by") &
+                                  clipp::value("TASK", affected_by_))) %
+                   "only builds the given task and the tasks that depend on it; "
+                   "can be given multiple times",
+
+               (clipp::option("--affected") >> affected_) %
+                   "only builds tasks that changed since they were last installed "
+                   "and the tasks that depend on them",
+
                (clipp::opt_values(clipp::match::prefix_not("-"), "task", tasks_)) %
                    "tasks to run; specify 'super' to only build modorganizer "
                    "projects";
@@ -155,6 +166,9 @@ namespace mob {
         try {
             create_prefix_ini();
 
+            if (!set_affected())
+                return 1;
+
             task_manager::instance().run_all();
 
             if (!keep_msbuild_)
@@ -169,6 +183,39 @@ namespace mob {
         }
     }
 
+    bool build_command::set_affected()
+    {
+        auto& tm = task_manager::instance();
+
+        if (!affected_by_.empty()) {
+            std::vector<task*> tasks;
+
+            for (auto&& pattern : affected_by_) {
+                const auto v = tm.find(pattern);
+
+                if (v.empty()) {
+                    gcx().error(context::generic, "no task matches '{}'", pattern);
+                    return false;
+                }
+
+                tasks.insert(tasks.end(), v.begin(), v.end());
+            }
+
+            std::vector<std::string> names;
+            for (auto* t : tm.dependents(tasks))
+                names.push_back(t->name());
+
+            gcx().info(context::generic, "affected tasks: {}", join(names, ", "));
+
+            tm.set_affected_by(tasks);
+        }
+
+        if (affected_)
+            tm.set_affected_by_changes(true);
+
+        return true;
+    }
+
     void build_command::create_prefix_ini()
     {
         const auto prefix = conf().path().prefix();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../utility/enum.h"
+#include "../utility/fs.h"
 #include <clipp.h>
 #include <filesystem>
 #include <optional>
@@ -211,6 +212,13 @@ namespace mob {
         bool ignore_uncommitted_ = false;
         bool keep_msbuild_       = false;
         std::optional<bool> revert_ts_;
+        std::vector<std::string> affected_by_;
+        bool affected_ = false;
+
+        // handles --affected-by and --affected, returns false if a task name
+        // is invalid
+        //
+        bool set_affected();
 
         // creates a bare bones ini file in the prefix so mob can be invoked in any
         // directory below it
@@ -289,6 +297,11 @@ namespace mob {
         void make_src();
         void make_installer();
 
+        // creates the archives enabled by bin_, pdbs_ and src_, concurrently if
+        // [release] parallel is set
+        //
+        void make_archives();
+
     protected:
         clipp::group do_group() override;
         int do_run() override;
@@ -313,6 +326,10 @@ namespace mob {
         bool force_ = false;
         std::string suffix_;
         std::string branch_;
+        bool src_from_git_ = false;
+
+        // threads given to each 7z process, set by make_archives()
+        std::size_t archive_threads_ = 0;
 
         int do_devbuild();
         int do_official();
@@ -323,9 +340,10 @@ namespace mob {
 
         fs::path make_filename(const std::string& what) const;
 
-        void walk_dir(const fs::path& dir, std::vector<fs::path>& files,
-                      const std::vector<std::regex>& ignore_re,
-                      std::size_t& total_size);
+        // runs `git ls-files` concurrently in every repo of modorganizer_super and
+        // returns the tracked files that don't match `ignore_re`
+        //
+        std::vector<walked_file> git_source_files(const std::regex& ignore_re) const;
 
         std::string version_from_exe() const;
         std::string version_from_rc() const;
@@ -344,7 +362,14 @@ namespace mob {
         std::string do_doc() override;
 
     private:
-        enum class modes { none = 0, set_remotes, add_remote, ignore_ts, branches };
+        enum class modes {
+            none = 0,
+            set_remotes,
+            add_remote,
+            ignore_ts,
+            branches,
+            fetch_all
+        };
 
         modes mode_ = modes::none;
         std::string username_;
@@ -356,6 +381,7 @@ namespace mob {
         bool nopush_       = false;
         bool push_default_ = false;
         bool all_branches_ = false;
+        int jobs_          = 0;
 
         void do_set_remotes();
         void do_set_remotes(const fs::path& r);
@@ -368,6 +394,8 @@ namespace mob {
 
         void do_branches();
 
+        void do_fetch_all();
+
         std::vector<fs::path> get_repos() const;
     };
 
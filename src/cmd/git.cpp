@@ -1,6 +1,8 @@
 #include "pch.h"
+#include "../core/conf.h"
 #include "../tasks/tasks.h"
 #include "../tools/tools.h"
+#include "../utility/threading.h"
 #include "commands.h"
 
 namespace mob {
@@ -71,7 +73,14 @@ namespace mob {
 
                 "branches" % (clipp::command("branches").set(mode_, modes::branches),
                               clipp::option("-a", "--all").set(all_branches_) %
-                                  "shows all branches, including those on master"));
+                                  "shows all branches, including those on master")
+
+                |
+
+                "fetch-all" %
+                    (clipp::command("fetch-all").set(mode_, modes::fetch_all),
+                     (clipp::option("-j", "--jobs") & clipp::value("N") >> jobs_) %
+                         "maximum number of concurrent fetches"));
     }
 
     int git_command::do_run()
@@ -97,6 +106,11 @@ namespace mob {
             break;
         }
 
+        case modes::fetch_all: {
+            do_fetch_all();
+            break;
+        }
+
         case modes::none:
         default:
             u8cerr << "bad git mode " << static_cast<int>(mode_) << "\n";
@@ -127,7 +141,11 @@ namespace mob {
                "\n"
                "branches\n"
                "  Lists all git repos that are not on master. With -a, show all \n"
-               "  repos and their current branch.";
+               "  repos and their current branch.\n"
+               "\n"
+               "fetch-all\n"
+               "  Runs `git fetch --all` in all repos concurrently and shows how\n"
+               "  many remote refs were updated in each.";
     }
 
     void git_command::do_set_remotes()
@@ -217,6 +235,112 @@ namespace mob {
         u8cout << table(v, 0, 3) << "\n";
     }
 
+    void git_command::do_fetch_all()
+    {
+        const auto repos = get_repos();
+
+        const int jobs = (jobs_ > 0 ? jobs_ : conf().global().git_fetch_jobs());
+        const std::size_t max =
+            static_cast<std::size_t>(std::max(1, std::min<int>(jobs, 64)));
+
+        u8cout << "fetching " << repos.size() << " repos, " << max
+               << " at a time\n";
+
+        struct result {
+            std::string repo;
+            std::string status;
+            bool failed = false;
+        };
+
+        std::vector<result> results(repos.size());
+        std::mutex error_mutex;
+        std::optional<bailed> error;
+
+        thread_pool tp(max);
+
+        for (std::size_t i = 0; i < repos.size(); ++i) {
+            tp.add([&, i] {
+                const auto& r = repos[i];
+                auto& res     = results[i];
+
+                res.repo = path_to_utf8(r.filename());
+
+                try {
+                    git_wrap g(r);
+
+                    const auto start  = std::chrono::steady_clock::now();
+                    const auto before = g.remote_refs();
+                    const int code    = g.fetch_all();
+
+                    const auto time = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start);
+
+                    if (code != 0) {
+                        res.failed = true;
+                        res.status = std::format("failed, exit code {}", code);
+                    }
+                    else {
+                        const auto after = g.remote_refs();
+
+                        // refs that were added, moved or pruned
+                        std::size_t changed = 0;
+
+                        for (auto&& [ref, hash] : after) {
+                            auto itor = before.find(ref);
+                            if (itor == before.end() || itor->second != hash)
+                                ++changed;
+                        }
+
+                        for (auto&& [ref, hash] : before) {
+                            if (!after.contains(ref))
+                                ++changed;
+                        }
+
+                        if (changed == 0)
+                            res.status = "up to date";
+                        else
+                            res.status = std::format("{} refs updated", changed);
+                    }
+
+                    res.status += std::format(" ({:.1f}s)", time.count());
+
+                    u8cout.write_ln(std::format("{}: {}", res.repo, res.status));
+                }
+                catch (bailed& e) {
+                    std::scoped_lock lock(error_mutex);
+                    if (!error)
+                        error = e;
+                }
+            });
+        }
+
+        tp.join();
+
+        if (error)
+            throw *error;
+
+        std::vector<std::pair<std::string, std::string>> v;
+        std::size_t failed = 0;
+
+        for (auto&& res : results) {
+            v.push_back({res.repo, res.status});
+
+            if (res.failed)
+                ++failed;
+        }
+
+        std::sort(v.begin(), v.end());
+
+        u8cout << "\n" << table(v, 0, 3) << "\n";
+
+        if (failed > 0) {
+            gcx().error(context::generic, "{} of {} repos failed to fetch", failed,
+                        repos.size());
+
+            throw bailed();
+        }
+    }
+
     std::vector<fs::path> git_command::get_repos() const
     {
         std::vector<fs::path> v;
@@ -23,30 +23,32 @@ namespace mob {
     void release_command::make_bin()
     {
         const auto out = out_ / make_filename("");
-        u8cout << "making binary archive " << path_to_utf8(out) << "\n";
+        u8cout.write_ln(std::format("making binary archive {}", path_to_utf8(out)));
 
         op::archive_from_glob(gcx(), conf().path().install_bin() / "*", out,
-                              {"__pycache__"});
+                              {"__pycache__"}, conf().release().compression("bin"),
+                              archive_threads_);
     }
 
     void release_command::make_pdbs()
     {
         const auto out = out_ / make_filename("pdbs");
-        u8cout << "making pdbs archive " << path_to_utf8(out) << "\n";
+        u8cout.write_ln(std::format("making pdbs archive {}", path_to_utf8(out)));
 
         op::archive_from_glob(gcx(), conf().path().install_pdbs() / "*", out,
-                              {"__pycache__"});
+                              {"__pycache__"}, conf().release().compression("pdbs"),
+                              archive_threads_);
     }
 
     void release_command::make_src()
     {
         const auto out = out_ / make_filename("src");
-        u8cout << "making src archive " << path_to_utf8(out) << "\n";
+        u8cout.write_ln(std::format("making src archive {}", path_to_utf8(out)));
 
         const std::vector<std::string> ignore = {"\\..+",  // dot files
                                                  "explorer\\+\\+",
                                                  "stylesheets",
-                                                 "transifex-translations"
+                                                 "transifex-translations",
                                                  ".*\\.log",
                                                  ".*\\.tlog",
                                                  ".*\\.dll",
@@ -58,18 +60,48 @@ namespace mob {
                                                  "(bin|lib)",
                                                  "vsbuild(32|64)?"};
 
-        const std::vector<std::regex> ignore_re(ignore.begin(), ignore.end());
+        // all the patterns are combined in a single regex so each filename is
+        // only matched once
+        std::string ignore_pattern;
+        for (auto&& i : ignore) {
+            if (!ignore_pattern.empty())
+                ignore_pattern += "|";
 
-        std::vector<fs::path> files;
-        std::size_t total_size = 0;
+            ignore_pattern += "(?:" + i + ")";
+        }
+
+        const std::regex ignore_re(ignore_pattern, std::regex::optimize);
 
         if (!fs::exists(tasks::modorganizer::super_path())) {
             gcx().bail_out(context::generic, "modorganizer super path not found: {}",
                            tasks::modorganizer::super_path());
         }
 
-        // build list list
-        walk_dir(tasks::modorganizer::super_path(), files, ignore_re, total_size);
+        // build file list, either from git or by walking the tree, directories
+        // are walked concurrently
+        std::vector<walked_file> walked;
+
+        if (conf().release().src_from_git()) {
+            walked = git_source_files(ignore_re);
+        }
+        else {
+            walked = walk_directory(gcx(), tasks::modorganizer::super_path(),
+                                    [&](const fs::directory_entry& e) {
+                                        return std::regex_match(
+                                            path_to_utf8(e.path().filename()),
+                                            ignore_re);
+                                    });
+        }
+
+        std::vector<fs::path> files;
+        std::size_t total_size = 0;
+
+        files.reserve(walked.size());
+
+        for (auto&& f : walked) {
+            files.push_back(f.path);
+            total_size += f.size;
+        }
 
         // should be below 20MB
         const std::size_t max_expected_size = 20 * 1024 * 1024;
@@ -84,50 +116,209 @@ namespace mob {
             }
         }
 
-        op::archive_from_files(gcx(), files, tasks::modorganizer::super_path(), out);
+        op::archive_from_files(gcx(), files, tasks::modorganizer::super_path(), out,
+                               conf().release().compression("src"), archive_threads_);
     }
 
-    void release_command::make_installer()
+    std::vector<walked_file>
+    release_command::git_source_files(const std::regex& ignore_re) const
     {
-        const auto file = "Mod.Organizer-" + version_ + ".exe";
-        const auto src  = conf().path().install_installer() / file;
-        const auto dest = out_;
+        const auto super = tasks::modorganizer::super_path();
 
-        u8cout << "copying installer " << file << "\n";
+        // every directory in super that has a .git, which is a file for
+        // submodules
+        std::vector<fs::path> repos;
 
-        op::copy_file_to_dir_if_better(gcx(), src, dest);
+        std::error_code ec;
+        fs::directory_iterator itor(super, ec);
+
+        for (; !ec && itor != fs::directory_iterator(); itor.increment(ec)) {
+            const auto& e = *itor;
+            std::error_code ignored;
+
+            if (!e.is_directory(ignored))
+                continue;
+
+            if (std::regex_match(path_to_utf8(e.path().filename()), ignore_re))
+                continue;
+
+            if (fs::exists(e.path() / ".git", ignored))
+                repos.push_back(e.path());
+        }
+
+        if (ec) {
+            gcx().bail_out(context::generic, "can't list repos in {}, {}", super,
+                           ec.message());
+        }
+
+        gcx().debug(context::generic, "listing tracked files in {} repos",
+                    repos.size());
+
+        std::vector<walked_file> files;
+        std::mutex files_mutex;
+        std::exception_ptr error;
+
+        thread_pool tp;
+
+        for (auto&& r : repos) {
+            tp.add([&, r] {
+                try {
+                    std::vector<walked_file> repo_files;
+
+                    for (auto&& rel : git_wrap(r).tracked_files()) {
+                        // same filter as when walking the tree, but applied to
+                        // every component since directories aren't visited
+                        const bool ignored =
+                            std::any_of(rel.begin(), rel.end(), [&](auto&& c) {
+                                return std::regex_match(path_to_utf8(c), ignore_re);
+                            });
+
+                        if (ignored)
+                            continue;
+
+                        // deleted files and submodules don't have a size
+                        std::error_code ec;
+                        const auto size = fs::file_size(r / rel, ec);
+
+                        if (ec)
+                            continue;
+
+                        repo_files.push_back({r / rel, size});
+                    }
+
+                    std::scoped_lock lock(files_mutex);
+                    files.insert(files.end(), repo_files.begin(), repo_files.end());
+                }
+                catch (bailed&) {
+                    // already logged
+                    std::scoped_lock lock(files_mutex);
+
+                    if (!error)
+                        error = std::current_exception();
+                }
+                catch (std::exception& e) {
+                    gcx().error(context::generic, "{}", e.what());
+                    std::scoped_lock lock(files_mutex);
+
+                    if (!error)
+                        error = std::current_exception();
+                }
+            });
+        }
+
+        tp.join();
+
+        if (error)
+            std::rethrow_exception(error);
+
+        // repos finish in any order, keep the archive reproducible
+        std::sort(files.begin(), files.end(), [](auto&& a, auto&& b) {
+            return a.path < b.path;
+        });
+
+        return files;
     }
 
-    void release_command::walk_dir(const fs::path& dir, std::vector<fs::path>& files,
-                                   const std::vector<std::regex>& ignore_re,
-                                   std::size_t& total_size)
+    void release_command::make_archives()
     {
-        // adds all files that are not in the ignore list to `files`, recursive
+        // each archive with the file it creates, deleted if it fails so a
+        // partial archive isn't left behind
+        std::vector<std::pair<fs::path, std::function<void()>>> archives;
 
-        for (auto e : fs::directory_iterator(dir)) {
-            const auto p        = e.path();
-            const auto filename = path_to_utf8(p.filename());
+        if (bin_)
+            archives.push_back({out_ / make_filename(""), [&] {
+                                    make_bin();
+                                }});
 
-            bool ignored = false;
+        if (pdbs_)
+            archives.push_back({out_ / make_filename("pdbs"), [&] {
+                                    make_pdbs();
+                                }});
 
-            for (auto&& re : ignore_re) {
-                if (std::regex_match(filename, re)) {
-                    ignored = true;
-                    break;
-                }
-            }
+        if (src_)
+            archives.push_back({out_ / make_filename("src"), [&] {
+                                    make_src();
+                                }});
 
-            if (ignored)
-                continue;
+        const bool parallel = conf().release().parallel() && archives.size() > 1;
+        const int threads   = conf().release().threads();
 
-            if (e.is_directory()) {
-                walk_dir(e.path(), files, ignore_re, total_size);
+        if (threads > 0) {
+            archive_threads_ = static_cast<std::size_t>(threads);
+        }
+        else if (parallel) {
+            // split the cores between the archives instead of having each 7z
+            // process use all of them
+            archive_threads_ = std::max<std::size_t>(
+                1, std::thread::hardware_concurrency() / archives.size());
+        }
+        else {
+            // let 7z decide
+            archive_threads_ = 0;
+        }
+
+        auto run = [&](auto&& a) {
+            try {
+                a.second();
             }
-            else if (e.is_regular_file()) {
-                total_size += fs::file_size(p);
-                files.push_back(p);
+            catch (...) {
+                op::delete_file(gcx(), a.first, op::optional);
+                throw;
             }
+        };
+
+        if (!parallel) {
+            for (auto&& a : archives)
+                run(a);
+
+            return;
         }
+
+        // the archives don't depend on each other, and the src archive spends
+        // most of its time walking the tree, so run them all at once; any
+        // exception escaping a thread would terminate mob, so the first error,
+        // including filesystem errors, is rethrown once they're all done
+        thread_pool tp(archives.size());
+        std::mutex error_mutex;
+        std::exception_ptr error;
+
+        for (auto&& a : archives) {
+            tp.add([&, a] {
+                try {
+                    run(a);
+                }
+                catch (bailed&) {
+                    // already logged
+                    std::scoped_lock lock(error_mutex);
+
+                    if (!error)
+                        error = std::current_exception();
+                }
+                catch (std::exception& e) {
+                    gcx().error(context::generic, "{}", e.what());
+                    std::scoped_lock lock(error_mutex);
+
+                    if (!error)
+                        error = std::current_exception();
+                }
+            });
+        }
+
+        tp.join();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    void release_command::make_installer()
+    {
+        const auto file = "Mod.Organizer-" + version_ + ".exe";
+        const auto src  = conf().path().install_installer() / file;
+        const auto dest = out_;
+
+        u8cout << "copying installer " << file << "\n";
+
+        op::copy_file_to_dir_if_better(gcx(), src, dest);
     }
 
     fs::path release_command::make_filename(const std::string& what) const
@@ -196,6 +387,9 @@ namespace mob {
                      (clipp::option("--suffix") & clipp::value("SUFFIX") >> suffix_) %
                          "optional suffix to add to the archive filenames",
 
+                     clipp::option("--src-from-git").set(src_from_git_) %
+                         "makes the source archive from the files tracked by git",
+
                      clipp::option("--force").set(force_) %
                          "ignores file size warnings and existing release directories")
 
@@ -210,6 +404,9 @@ namespace mob {
     {
         command::convert_cl_to_conf();
 
+        if (src_from_git_)
+            common.options.push_back("release/src_from_git=true");
+
         if (mode_ == modes::official) {
             // force enable translations, installer and tx
 
@@ -248,14 +445,7 @@ namespace mob {
             << "\n"
             << "creating release for " << version_ << "\n";
 
-        if (bin_)
-            make_bin();
-
-        if (pdbs_)
-            make_pdbs();
-
-        if (src_)
-            make_src();
+        make_archives();
 
         if (installer_)
             make_installer();
@@ -279,9 +469,7 @@ namespace mob {
         build_command::terminate_msbuild();
 
         prepare();
-        make_bin();
-        make_pdbs();
-        make_src();
+        make_archives();
         make_installer();
 
         return 0;
@@ -291,27 +479,32 @@ namespace mob {
     {
         u8cout << "checking repos for branch " << branch_ << "...\n";
 
-        thread_pool tp;
-        std::atomic<bool> failed = false;
+        std::vector<const tasks::modorganizer*> repos;
+        std::vector<mob::url> urls;
 
         for (const auto* t : task_manager::instance().find("super")) {
             if (!t->enabled())
                 continue;
 
-            tp.add([this, t, &failed] {
-                const auto* o = dynamic_cast<const tasks::modorganizer*>(t);
+            const auto* o = dynamic_cast<const tasks::modorganizer*>(t);
+            repos.push_back(o);
+            urls.push_back(o->git_url());
+        }
 
-                if (!git_wrap::remote_branch_exists(o->git_url(), branch_)) {
-                    gcx().error(context::generic,
-                                "branch {} doesn't exist in the {} repo", branch_,
-                                o->name());
+        // lists the branches of all repos concurrently, the checks below use
+        // the cache
+        git_remote_refs::instance().prefetch(urls);
 
-                    failed = true;
-                }
-            });
-        }
+        bool failed = false;
 
-        tp.join();
+        for (const auto* o : repos) {
+            if (!git_wrap::remote_branch_exists(o->git_url(), branch_)) {
+                gcx().error(context::generic, "branch {} doesn't exist in the {} repo",
+                            branch_, o->name());
+
+                failed = true;
+            }
+        }
 
         if (failed) {
             gcx().bail_out(context::generic,
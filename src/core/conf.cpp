@@ -200,6 +200,21 @@ namespace mob::details {
         return bool_from_string(s);
     }
 
+    // calls get_string_for_task(), converts to int
+    //
+    int get_int_for_task(const std::vector<std::string>& task_names,
+                         std::string_view key)
+    {
+        const std::string s = get_string_for_task(task_names, key);
+
+        try {
+            return std::stoi(s);
+        }
+        catch (std::exception&) {
+            gcx().bail_out(context::conf, "bad int for {}/{}", task_names[0], key);
+        }
+    }
+
     // sets the given task option, bails out if the option doesn't exist
     //
     void set_string_for_task(const std::string& task_name, const std::string& key,
@@ -320,6 +335,24 @@ namespace mob {
         return lines;
     }
 
+    std::string options_string(const std::vector<std::string>& sections)
+    {
+        std::string s;
+
+        for (auto&& section : sections) {
+            auto itor = details::g_conf.find(section);
+            if (itor == details::g_conf.end())
+                continue;
+
+            // maps are sorted, so the string is always the same for the same
+            // options
+            for (auto&& [k, v] : itor->second)
+                s += section + "/" + k + "=" + v + "\n";
+        }
+
+        return s;
+    }
+
     // sets commonly used options that need to be converted to int/bool, for
     // performance
     //
@@ -539,6 +572,7 @@ namespace mob {
         const auto p = conf().path();
 
         resolve_path("cache", p.prefix(), "downloads");
+        resolve_path("compiler_cache", p.prefix(), "compiler_cache");
         resolve_path("build", p.prefix(), "build");
         resolve_path("install", p.prefix(), "install");
         resolve_path("install_installer", p.install(), "installer");
@@ -691,6 +725,11 @@ namespace mob {
         return {};
     }
 
+    conf_release conf::release()
+    {
+        return {};
+    }
+
     conf_tools conf::tool()
     {
         return {};
@@ -761,6 +800,62 @@ namespace mob {
         return details::get_string(name(), "host");
     }
 
+    fs::path conf_cmake::compiler_launcher() const
+    {
+        return details::get_string(name(), "compiler_launcher");
+    }
+
+    bool conf_cmake::superbuild() const
+    {
+        return details::get_bool(name(), "superbuild");
+    }
+
+    std::string conf_cmake::linker() const
+    {
+        return details::get_string(name(), "linker");
+    }
+
+    bool conf_cmake::split_dwarf() const
+    {
+        return details::get_bool(name(), "split_dwarf");
+    }
+
+    fs::path conf_cmake::distributed_compiler() const
+    {
+        return details::get_string(name(), "distributed_compiler");
+    }
+
+    std::string conf_cmake::distributed_hosts() const
+    {
+        return details::get_string(name(), "distributed_hosts");
+    }
+
+    std::string conf_cmake::distributed_scheduler() const
+    {
+        return details::get_string(name(), "distributed_scheduler");
+    }
+
+    int conf_cmake::distributed_jobs() const
+    {
+        return details::get_int(name(), "distributed_jobs");
+    }
+
+    static std::unordered_map<compression, std::string_view> compression_values{
+        {compression::store, "store"},
+        {compression::fast, "fast"},
+        {compression::normal, "normal"},
+        {compression::max, "max"}};
+
+    conf_release::conf_release() : conf_section("release") {}
+
+    mob::compression conf_release::compression(std::string_view what) const
+    {
+        const auto key = std::string(what) + "_compression";
+
+        return details::parse_cmake_value(
+            name(), key, details::get_string(name(), key), compression_values);
+    }
+
     conf_task::conf_task(std::vector<std::string> names) : names_(std::move(names)) {}
 
     std::string conf_task::get(std::string_view key) const
@@ -773,6 +868,16 @@ namespace mob {
         return details::get_bool_for_task(names_, key);
     }
 
+    std::vector<std::string> conf_task::git_sparse() const
+    {
+        return split(get("git_sparse"), " ");
+    }
+
+    int conf_task::unity_batch_size() const
+    {
+        return details::get_int_for_task(names_, "unity_batch_size");
+    }
+
     mob::config conf_task::configuration() const
     {
         return details::parse_cmake_value(
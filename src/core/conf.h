@@ -55,6 +55,11 @@ namespace mob {
     //
     std::vector<std::string> format_options();
 
+    // returns all the options in the given sections as "section/key=value" lines,
+    // used to detect changes in options between runs
+    //
+    std::string options_string(const std::vector<std::string>& sections);
+
     // base class for all conf structs
     //
     template <class DefaultType>
@@ -122,6 +127,7 @@ namespace mob {
         bool clean() const { return get<bool>("clean_task"); }
         bool fetch() const { return get<bool>("fetch_task"); }
         bool build() const { return get<bool>("build_task"); }
+        int git_fetch_jobs() const { return get<int>("git_fetch_jobs"); }
     };
 
     // options in [cmake]
@@ -145,6 +151,77 @@ namespace mob {
         // an empty string means no host configured
         //
         std::string host() const;
+
+        // cache tool given to CMAKE_<LANG>_COMPILER_LAUNCHER, such as ccache or
+        // sccache
+        //
+        // an empty path means no launcher
+        //
+        fs::path compiler_launcher() const;
+
+        // whether all MO projects are built in one cmake build, see the superbuild
+        // task
+        //
+        bool superbuild() const;
+
+        // linker given to CMAKE_LINKER_TYPE, such as mold or lld
+        //
+        // an empty string means the default linker of the toolchain
+        //
+        std::string linker() const;
+
+        // whether debug information is kept in .dwo files next to the objects
+        // for RelWithDebInfo, ignored on windows
+        //
+        bool split_dwarf() const;
+
+        // distributed compiler, such as distcc or icecc, used as the compiler
+        // launcher, or as CCACHE_PREFIX when compiler_launcher is also set
+        //
+        // an empty path means compiling locally
+        //
+        fs::path distributed_compiler() const;
+
+        // passed as DISTCC_HOSTS, empty to use distcc's own configuration
+        //
+        std::string distributed_hosts() const;
+
+        // "host:port" that must be reachable before building, such as a distccd
+        // or the icecream scheduler; when empty, the hosts from
+        // distributed_hosts are checked instead
+        //
+        std::string distributed_scheduler() const;
+
+        // number of parallel jobs for each project when compiling remotely, 0
+        // for four times the number of cores
+        //
+        int distributed_jobs() const;
+    };
+
+    // options in [release]
+    //
+    class conf_release : public conf_section<std::string> {
+    public:
+        conf_release();
+
+        // whether the archives are created concurrently
+        //
+        bool parallel() const { return get<bool>("parallel"); }
+
+        // number of threads each 7z process can use, 0 means the cores are split
+        // between archives that are created concurrently
+        //
+        int threads() const { return get<int>("threads"); }
+
+        // whether the source archive is made from the files tracked by git in
+        // each repo instead of walking the whole tree
+        //
+        bool src_from_git() const { return get<bool>("src_from_git"); }
+
+        // compression profile for the given archive, `what` is "bin", "pdbs" or
+        // "src"
+        //
+        mob::compression compression(std::string_view what) const;
     };
 
     // options in [task] or [task_name:task]
@@ -166,6 +243,15 @@ namespace mob {
         bool ignore_ts() const { return get_bool("ignore_ts"); }
         std::string git_url_prefix() const { return get("git_url_prefix"); }
         bool git_shallow() const { return get_bool("git_shallow"); }
+        bool git_mirror() const { return get_bool("git_mirror"); }
+        bool skip_up_to_date() const { return get_bool("skip_up_to_date"); }
+        bool install_changed_only() const { return get_bool("install_changed_only"); }
+        bool combined_install() const { return get_bool("combined_install"); }
+        bool unity_build() const { return get_bool("unity_build"); }
+        int unity_batch_size() const;
+        bool precompiled_headers() const { return get_bool("precompiled_headers"); }
+        std::string git_filter() const { return get("git_filter"); }
+        std::vector<std::string> git_sparse() const;
         std::string git_user() const { return get("git_username"); }
         std::string git_email() const { return get("git_email"); }
         bool set_origin_remote() const { return get_bool("set_origin_remote"); }
@@ -246,6 +332,7 @@ namespace mob {
         VALUE(third_party);
         VALUE(prefix);
         VALUE(cache);
+        VALUE(compiler_cache);
         VALUE(licenses);
         VALUE(build);
 
@@ -282,6 +369,7 @@ namespace mob {
         conf_global global();
         conf_task task(const std::vector<std::string>& names);
         conf_cmake cmake();
+        conf_release release();
         conf_tools tool();
         conf_transifex transifex();
         conf_prebuilt prebuilt();
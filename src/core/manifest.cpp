@@ -0,0 +1,218 @@
+#include "pch.h"
+#include "manifest.h"
+#include "../utility/threading.h"
+#include "context.h"
+#include "op.h"
+
+namespace mob {
+
+    namespace {
+
+        // same as hash_string(), but reads the file in chunks; returns an empty
+        // string if the file can't be read
+        //
+        std::string hash_file(const fs::path& p)
+        {
+            std::ifstream in(p, std::ios::binary);
+            if (!in)
+                return {};
+
+            std::vector<char> buffer(1024 * 1024);
+            std::uint64_t h = 0xcbf29ce484222325ull;
+
+            while (in) {
+                in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                const auto n = static_cast<std::size_t>(in.gcount());
+
+                for (std::size_t i = 0; i < n; ++i) {
+                    h ^= static_cast<unsigned char>(buffer[i]);
+                    h *= 0x100000001b3ull;
+                }
+            }
+
+            return std::format("{:016x}", h);
+        }
+
+        // paths are always saved with forward slashes so the manifest and its
+        // hash are the same whether they were loaded or built from the files
+        //
+        std::string path_string(const fs::path& p)
+        {
+            auto s = path_to_utf8(p);
+            std::replace(s.begin(), s.end(), '\\', '/');
+            return s;
+        }
+
+    }  // namespace
+
+    install_manifest install_manifest::from_files(const context& cx,
+                                                  const fs::path& root,
+                                                  const std::vector<fs::path>& files)
+    {
+        install_manifest m;
+        m.entries_.resize(files.size());
+
+        // files are split in one contiguous range per thread, each thread only
+        // writes to its own entries
+        const std::size_t threads =
+            std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1,
+                                    std::max<std::size_t>(files.size(), 1));
+
+        const std::size_t per_thread = (files.size() + threads - 1) / threads;
+
+        {
+            thread_pool tp(threads);
+
+            for (std::size_t t = 0; t < threads; ++t) {
+                const std::size_t begin = t * per_thread;
+                const std::size_t end   = std::min(begin + per_thread, files.size());
+
+                if (begin >= end)
+                    break;
+
+                tp.add([&, begin, end] {
+                    for (std::size_t i = begin; i < end; ++i) {
+                        auto& e = m.entries_[i];
+
+                        std::error_code ec;
+                        e.path = files[i].lexically_relative(root).make_preferred();
+                        e.size = fs::file_size(files[i], ec);
+                        e.hash = hash_file(files[i]);
+
+                        if (ec || e.hash.empty()) {
+                            cx.warning(context::fs, "can't hash {} for the manifest",
+                                       files[i]);
+                        }
+                    }
+                });
+            }
+        }
+
+        std::sort(m.entries_.begin(), m.entries_.end(), [](auto&& a, auto&& b) {
+            return (a.path < b.path);
+        });
+
+        return m;
+    }
+
+    install_manifest install_manifest::load(const context& cx, const fs::path& file)
+    {
+        install_manifest m;
+
+        if (!fs::exists(file))
+            return m;
+
+        const auto text = op::read_text_file(cx, encodings::utf8, file, op::optional);
+
+        // a bad size means the file is corrupted, nothing in it can be trusted
+        bool bad = false;
+
+        // each line is "hash size path", the path may contain spaces
+        for_each_line(text, [&](auto&& line) {
+            const auto s1 = line.find(' ');
+            if (bad || s1 == std::string_view::npos)
+                return;
+
+            const auto s2 = line.find(' ', s1 + 1);
+            if (s2 == std::string_view::npos)
+                return;
+
+            entry e;
+            e.hash = std::string(line.substr(0, s1));
+            e.path = fs::path(utf8_to_utf16(line.substr(s2 + 1))).make_preferred();
+
+            try {
+                e.size = std::stoull(std::string(line.substr(s1 + 1, s2 - s1 - 1)));
+            }
+            catch (std::exception&) {
+                bad = true;
+                return;
+            }
+
+            m.entries_.push_back(std::move(e));
+        });
+
+        if (bad) {
+            cx.warning(context::fs, "manifest {} is corrupted, ignoring", file);
+            return {};
+        }
+
+        std::sort(m.entries_.begin(), m.entries_.end(), [](auto&& a, auto&& b) {
+            return (a.path < b.path);
+        });
+
+        return m;
+    }
+
+    void install_manifest::save(const context& cx, const fs::path& file) const
+    {
+        std::string text;
+
+        for (auto&& e : entries_)
+            text += std::format("{} {} {}\n", e.hash, e.size, path_string(e.path));
+
+        op::create_directories(cx, file.parent_path());
+        op::write_text_file(cx, encodings::utf8, file, text);
+    }
+
+    std::vector<fs::path>
+    install_manifest::changed_since(const install_manifest& old) const
+    {
+        std::vector<fs::path> v;
+
+        for (auto&& e : entries_) {
+            const auto* o = old.find(e.path);
+            if (!o || o->size != e.size || o->hash != e.hash)
+                v.push_back(e.path);
+        }
+
+        return v;
+    }
+
+    std::vector<fs::path>
+    install_manifest::removed_since(const install_manifest& old) const
+    {
+        std::vector<fs::path> v;
+
+        for (auto&& o : old.entries_) {
+            if (!find(o.path))
+                v.push_back(o.path);
+        }
+
+        return v;
+    }
+
+    std::string install_manifest::hash() const
+    {
+        std::string s;
+
+        for (auto&& e : entries_)
+            s += std::format("{} {} {}\n", e.hash, e.size, path_string(e.path));
+
+        return hash_string(s);
+    }
+
+    const std::vector<install_manifest::entry>& install_manifest::entries() const
+    {
+        return entries_;
+    }
+
+    bool install_manifest::empty() const
+    {
+        return entries_.empty();
+    }
+
+    const install_manifest::entry* install_manifest::find(const fs::path& p) const
+    {
+        auto itor = std::lower_bound(entries_.begin(), entries_.end(), p,
+                                     [](auto&& e, auto&& path) {
+                                         return (e.path < path);
+                                     });
+
+        if (itor == entries_.end() || itor->path != p)
+            return nullptr;
+
+        return &*itor;
+    }
+
+}  // namespace mob
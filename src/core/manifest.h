@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../utility.h"
+
+namespace mob {
+
+    class context;
+
+    // list of files installed by a task along with their size and a hash of their
+    // content, saved next to the task's stamp after every install
+    //
+    // comparing the manifest from the last install with the current one tells
+    // which files actually changed, which is used to report changes, to only
+    // copy changed files to the install directory and to figure out whether
+    // tasks that depend on this one have to be rebuilt
+    //
+    class install_manifest {
+    public:
+        struct entry {
+            // relative to the root given to from_files()
+            fs::path path;
+            std::uintmax_t size = 0;
+            std::string hash;
+        };
+
+        // hashes all the given files, which must be inside `root`; the paths in
+        // the manifest are relative to `root`
+        //
+        static install_manifest from_files(const context& cx, const fs::path& root,
+                                           const std::vector<fs::path>& files);
+
+        // reads a manifest saved by save(), returns an empty manifest if the file
+        // doesn't exist or is corrupted
+        //
+        static install_manifest load(const context& cx, const fs::path& file);
+
+        // writes the manifest to the given file
+        //
+        void save(const context& cx, const fs::path& file) const;
+
+        // paths of the files that are not in `old` or have a different size or
+        // hash
+        //
+        std::vector<fs::path> changed_since(const install_manifest& old) const;
+
+        // paths of the files in `old` that are not in this manifest anymore
+        //
+        std::vector<fs::path> removed_since(const install_manifest& old) const;
+
+        // hash of all the entries, changes whenever any file changes
+        //
+        std::string hash() const;
+
+        // all entries, sorted by path
+        //
+        const std::vector<entry>& entries() const;
+
+        bool empty() const;
+
+    private:
+        std::vector<entry> entries_;
+
+        // returns the entry with the given path, null if not found
+        //
+        const entry* find(const fs::path& p) const;
+    };
+
+}  // namespace mob
@@ -0,0 +1,265 @@
+#include "pch.h"
+#include "ninja_log.h"
+#include "context.h"
+#include "op.h"
+
+namespace mob {
+
+    namespace {
+
+        build_timings::kinds kind_of(std::string_view output)
+        {
+            const auto ext = path_to_utf8(fs::path(output).extension());
+
+            if (ext == ".o" || ext == ".obj")
+                return build_timings::kinds::compile;
+
+            if (ext == ".exe" || ext == ".dll" || ext == ".so" || ext == ".a" ||
+                ext == ".lib" || ext == ".dylib" ||
+                output.find(".so.") != std::string_view::npos) {
+                return build_timings::kinds::link;
+            }
+
+            return build_timings::kinds::other;
+        }
+
+        std::string seconds(std::chrono::milliseconds ms)
+        {
+            return std::format("{:.1f}s", static_cast<double>(ms.count()) / 1000.0);
+        }
+
+        // returns the last line in the first `size` bytes of the given log,
+        // without the newline; empty if it doesn't end with a newline at `size`
+        //
+        std::string_view line_before(std::string_view log, std::size_t size)
+        {
+            if (size == 0 || size > log.size() || log[size - 1] != '\n')
+                return {};
+
+            const auto head = log.substr(0, size - 1);
+            const auto nl   = head.rfind('\n');
+
+            return (nl == std::string_view::npos ? head : head.substr(nl + 1));
+        }
+
+    }  // namespace
+
+    build_timings& build_timings::instance()
+    {
+        static build_timings t;
+        return t;
+    }
+
+    build_timings::log_mark build_timings::mark(const fs::path& build_dir)
+    {
+        const auto file = build_dir / ".ninja_log";
+
+        std::error_code ec;
+        const auto size = fs::file_size(file, ec);
+
+        if (ec || size == 0)
+            return {};
+
+        // only the end of the file is needed, lines are short
+        const std::uintmax_t tail = std::min<std::uintmax_t>(size, 4096);
+
+        std::ifstream in(file, std::ios::binary);
+        in.seekg(static_cast<std::streamoff>(size - tail));
+
+        std::string s(static_cast<std::size_t>(tail), '\0');
+        in.read(s.data(), static_cast<std::streamsize>(s.size()));
+
+        if (!in)
+            return {};
+
+        return {size, std::string(line_before(s, s.size()))};
+    }
+
+    void build_timings::add(const context& cx, const std::string& project,
+                            const fs::path& build_dir, const log_mark& since)
+    {
+        const auto file = build_dir / ".ninja_log";
+
+        if (!exists(file)) {
+            cx.trace(context::generic, "no {}, no build timings", file);
+            return;
+        }
+
+        const auto log = op::read_text_file(cx, encodings::utf8, file, op::optional);
+
+        std::vector<entry> v;
+
+        // ninja writes whole lines, so the line that ended the log before the
+        // build must still be right before `since`; a recompacted log that
+        // grew past its old size again would otherwise be read from the middle
+        // of a line
+        const bool appended =
+            (since.size == 0 ||
+             (since.size <= log.size() &&
+              line_before(log, static_cast<std::size_t>(since.size)) ==
+                  since.last_line));
+
+        if (!appended) {
+            cx.trace(context::generic, "{} was recompacted, reading the last build",
+                     file);
+
+            v = parse(project, log, true);
+        }
+        else {
+            const auto added =
+                std::string_view(log).substr(static_cast<std::size_t>(since.size));
+
+            v = parse(project, added, false);
+        }
+
+        cx.trace(context::generic, "{} build steps in {}", v.size(), file);
+
+        for (auto&& e : v)
+            cx.trace(context::generic, "  {} {}", seconds(e.duration), e.output);
+
+        std::scoped_lock lock(mutex_);
+        entries_.insert(entries_.end(), v.begin(), v.end());
+    }
+
+    std::vector<build_timings::entry> build_timings::parse(const std::string& project,
+                                                           std::string_view log,
+                                                           bool last_build_only)
+    {
+        std::vector<entry> v;
+
+        // steps with multiple outputs have one line per output, they're only
+        // counted once
+        std::set<std::tuple<long long, long long, std::string>> seen;
+
+        long long last_end = 0;
+
+        // each line is "start end mtime output hash", separated by tabs, times
+        // are in milliseconds since the start of the build
+        for_each_line(log, [&](auto&& line) {
+            if (line.empty() || line.starts_with("#"))
+                return;
+
+            const auto cols = split(std::string(line), "\t");
+            if (cols.size() < 5)
+                return;
+
+            long long start = 0, end = 0;
+
+            try {
+                start = std::stoll(cols[0]);
+                end   = std::stoll(cols[1]);
+            }
+            catch (std::exception&) {
+                return;
+            }
+
+            // new entries are appended to the log at every build, a new build
+            // starts when the times go back to zero
+            if (last_build_only && end < last_end) {
+                v.clear();
+                seen.clear();
+            }
+
+            last_end = end;
+
+            if (!seen.emplace(start, end, cols[4]).second)
+                return;
+
+            v.push_back({project, cols[3], std::chrono::milliseconds(end - start),
+                         kind_of(cols[3])});
+        });
+
+        return v;
+    }
+
+    void build_timings::report(const context& cx, std::size_t count) const
+    {
+        std::scoped_lock lock(mutex_);
+
+        if (entries_.empty())
+            return;
+
+        auto sorted = entries_;
+        std::sort(sorted.begin(), sorted.end(), [](auto&& a, auto&& b) {
+            return (a.duration > b.duration);
+        });
+
+        using rows = std::vector<std::pair<std::string, std::string>>;
+
+        auto log_table = [&](const rows& v) {
+            for_each_line(table(v, 2, 3), [&](auto&& line) {
+                cx.info(context::generic, "{}", line);
+            });
+        };
+
+        // slowest steps of the given kind
+        auto slowest = [&](kinds k, std::string_view what) {
+            rows v;
+
+            for (auto&& e : sorted) {
+                if (e.kind != k)
+                    continue;
+
+                v.emplace_back(seconds(e.duration), e.project + ": " + e.output);
+
+                if (v.size() >= count)
+                    break;
+            }
+
+            if (!v.empty()) {
+                cx.info(context::generic, "slowest {}:", what);
+                log_table(v);
+            }
+        };
+
+        slowest(kinds::compile, "compiles");
+        slowest(kinds::link, "links");
+
+        // totals per project, sorted by compile time
+        struct totals {
+            std::size_t units = 0;
+            std::chrono::milliseconds compile{0}, link{0}, other{0};
+        };
+
+        std::map<std::string, totals> per_project;
+
+        for (auto&& e : entries_) {
+            auto& t = per_project[e.project];
+
+            switch (e.kind) {
+            case kinds::compile:
+                ++t.units;
+                t.compile += e.duration;
+                break;
+
+            case kinds::link:
+                t.link += e.duration;
+                break;
+
+            case kinds::other:
+                t.other += e.duration;
+                break;
+            }
+        }
+
+        std::vector<std::pair<std::string, totals>> projects(per_project.begin(),
+                                                             per_project.end());
+
+        std::sort(projects.begin(), projects.end(), [](auto&& a, auto&& b) {
+            return (a.second.compile > b.second.compile);
+        });
+
+        rows v;
+
+        for (auto&& [name, t] : projects) {
+            v.emplace_back(name, std::format("{} units, {} compiling, {} linking, "
+                                             "{} other",
+                                             t.units, seconds(t.compile),
+                                             seconds(t.link), seconds(t.other)));
+        }
+
+        cx.info(context::generic, "build times per project:");
+        log_table(v);
+    }
+
+}  // namespace mob
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "../utility.h"
+
+namespace mob {
+
+    class context;
+
+    // timings of the build steps read from the .ninja_log files in the build
+    // directories of the tasks, singleton
+    //
+    // tasks call log_size() before building and add() after, which logs the
+    // steps of that build at the trace level; report() is called once at the
+    // end of the build and logs the slowest steps along with totals per
+    // project, which is useful to figure out which projects would benefit from
+    // unity builds or header cleanups
+    //
+    class build_timings {
+    public:
+        enum class kinds {
+            // compiling a translation unit, an object file
+            compile = 1,
+
+            // linking an executable, a shared library or an archive
+            link,
+
+            // anything else, like precompiled headers or custom commands
+            other
+        };
+
+        struct entry {
+            // name of the task
+            std::string project;
+
+            // output of the step, relative to the build directory
+            std::string output;
+
+            std::chrono::milliseconds duration;
+            kinds kind;
+        };
+
+        // where a .ninja_log ended before a build, see mark()
+        //
+        struct log_mark {
+            // size of the log, 0 if there wasn't one
+            std::uintmax_t size = 0;
+
+            // last line in the log, used to detect a log that was rewritten
+            std::string last_line;
+        };
+
+        static build_timings& instance();
+
+        // where the .ninja_log in the given directory currently ends; given to
+        // add() so only the steps that were added since are read
+        //
+        static log_mark mark(const fs::path& build_dir);
+
+        // reads the steps that were added to the .ninja_log in the given
+        // directory since `since` and keeps them for report(); does nothing if
+        // there is no log, such as with the visual studio generators
+        //
+        // ninja sometimes recompacts the log before building, which rewrites it;
+        // if the log doesn't have the same line at the end of `since` anymore,
+        // only the last build in it is read
+        //
+        void add(const context& cx, const std::string& project,
+                 const fs::path& build_dir, const log_mark& since);
+
+        // logs the `count` slowest compiles and links, and the totals for each
+        // project; does nothing if add() never found anything
+        //
+        void report(const context& cx, std::size_t count = 10) const;
+
+    private:
+        std::vector<entry> entries_;
+        mutable std::mutex mutex_;
+
+        // parses the content of a .ninja_log; with `last_build_only`, only keeps
+        // the steps from the last build in it
+        //
+        static std::vector<entry> parse(const std::string& project,
+                                        std::string_view log, bool last_build_only);
+    };
+
+}  // namespace mob
@@ -2,6 +2,7 @@
 #include "op.h"
 #include "../tools/tools.h"
 #include "../utility.h"
+#include "../utility/threading.h"
 #include "conf.h"
 #include "context.h"
 
@@ -368,8 +369,8 @@ namespace mob::op {
         }
     }
 
-    void copy_glob_to_dir_if_better(const context& cx, const fs::path& src_glob,
-                                    const fs::path& dest_dir, flags f)
+    copy_stats copy_glob_to_dir_if_better(const context& cx, const fs::path& src_glob,
+                                          const fs::path& dest_dir, flags f)
     {
         check(cx, dest_dir, f);
 
@@ -382,6 +383,14 @@ namespace mob::op {
                         src_glob, dest_dir, file_parent);
         }
 
+        // source files, relative to `file_parent` like the destination files
+        // are relative to `dest_dir`
+        std::vector<walked_file> sources;
+
+        // directories to create in `dest_dir`, including empty ones
+        std::vector<fs::path> dirs;
+        std::mutex dirs_mutex;
+
         for (auto&& e : fs::directory_iterator(file_parent)) {
             const auto name = e.path().filename().native();
 
@@ -393,7 +402,8 @@ namespace mob::op {
 
             if (e.is_regular_file()) {
                 if (f & copy_files) {
-                    copy_file_to_dir_if_better(cx, e.path(), dest_dir);
+                    sources.push_back({e.path().filename(), e.file_size(),
+                                       e.last_write_time()});
                 }
                 else {
                     cx.trace(context::fs, "file {} matched {} but files are not copied",
@@ -402,10 +412,26 @@ namespace mob::op {
             }
             else if (e.is_directory()) {
                 if (f & copy_dirs) {
-                    const fs::path sub = dest_dir / e.path().filename();
-
-                    create_directories(cx, sub);
-                    copy_glob_to_dir_if_better(cx, e.path() / "*", sub, f);
+                    dirs.push_back(e.path().filename());
+
+                    // the skip callback sees every subdirectory, which is how
+                    // empty ones are found
+                    auto files = walk_directory(cx, e.path(), [&](auto&& sub) {
+                        if (sub.is_directory()) {
+                            std::scoped_lock lock(dirs_mutex);
+                            dirs.push_back(sub.path().lexically_relative(file_parent));
+                        }
+
+                        return false;
+                    });
+
+                    // files in subdirectories are only copied with copy_files
+                    if (f & copy_files) {
+                        for (auto&& wf : files) {
+                            wf.path = wf.path.lexically_relative(file_parent);
+                            sources.push_back(std::move(wf));
+                        }
+                    }
                 }
                 else {
                     cx.trace(context::fs,
@@ -414,6 +440,107 @@ namespace mob::op {
                 }
             }
         }
+
+        // everything that's already in the destination, by relative path
+        std::map<fs::path, walked_file> existing;
+
+        if (fs::exists(dest_dir)) {
+            for (auto&& wf : walk_directory(cx, dest_dir, [](auto&&) {
+                     return false;
+                 })) {
+                existing.emplace(wf.path.lexically_relative(dest_dir), wf);
+            }
+        }
+
+        // same checks as is_source_better(), without touching the filesystem
+        copy_stats stats;
+        std::vector<const walked_file*> to_copy;
+
+        for (auto&& s : sources) {
+            auto itor = existing.find(s.path);
+
+            if (itor != existing.end() && itor->second.size == s.size &&
+                itor->second.time >= s.time) {
+                cx.trace(context::bypass, "(skipped) {} -> {}", file_parent / s.path,
+                         dest_dir);
+
+                ++stats.skipped;
+                continue;
+            }
+
+            cx.trace(context::fs, "{} -> {}", file_parent / s.path, dest_dir);
+
+            to_copy.push_back(&s);
+            ++stats.copied;
+            stats.bytes += s.size;
+        }
+
+        cx.debug(context::fs, "{} -> {}: {} files to copy ({} bytes), {} up to date",
+                 src_glob, dest_dir, stats.copied, stats.bytes, stats.skipped);
+
+        if (conf().global().dry())
+            return stats;
+
+        // parents first, so files can be copied without creating anything
+        std::sort(dirs.begin(), dirs.end());
+
+        create_directories(cx, dest_dir, f & unsafe);
+        for (auto&& d : dirs)
+            create_directories(cx, dest_dir / d, f & unsafe);
+
+        // files are split in one contiguous range per thread, which avoids
+        // queueing thousands of tiny copies one by one
+        const std::size_t threads =
+            std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1,
+                                    std::max<std::size_t>(to_copy.size(), 1));
+
+        const std::size_t per_thread = (to_copy.size() + threads - 1) / threads;
+
+        // first failure, rethrown once all the threads are done
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        {
+            thread_pool tp(threads);
+
+            for (std::size_t t = 0; t < threads; ++t) {
+                const std::size_t begin = t * per_thread;
+                const std::size_t end   = std::min(begin + per_thread, to_copy.size());
+
+                if (begin >= end)
+                    break;
+
+                tp.add([&, begin, end] {
+                    try {
+                        for (std::size_t i = begin; i < end; ++i) {
+                            const auto& s   = *to_copy[i];
+                            const auto src  = file_parent / s.path;
+                            const auto dest = dest_dir / s.path;
+
+                            std::error_code ec;
+                            fs::copy_file(src, dest,
+                                          fs::copy_options::overwrite_existing, ec);
+
+                            if (ec) {
+                                cx.bail_out(context::fs, "can't copy {} to {}, {}", src,
+                                            dest, ec.message());
+                            }
+                        }
+                    }
+                    catch (...) {
+                        std::scoped_lock lock(error_mutex);
+
+                        if (!error)
+                            error = std::current_exception();
+                    }
+                });
+            }
+        }
+
+        if (error)
+            std::rethrow_exception(error);
+
+        return stats;
     }
 
     void replace_file(const context& cx, const fs::path& src, const fs::path& dest,
@@ -517,7 +644,8 @@ namespace mob::op {
 
     void archive_from_glob(const context& cx, const fs::path& src_glob,
                            const fs::path& dest_file,
-                           const std::vector<std::string>& ignore, flags f)
+                           const std::vector<std::string>& ignore, compression c,
+                           std::size_t threads, flags f)
     {
         cx.trace(context::fs, "archiving {} into {}", src_glob, dest_file);
         check(cx, dest_file, f);
@@ -525,12 +653,12 @@ namespace mob::op {
         if (conf().global().dry())
             return;
 
-        archiver::create_from_glob(cx, dest_file, src_glob, ignore);
+        archiver::create_from_glob(cx, dest_file, src_glob, ignore, c, threads);
     }
 
     void archive_from_files(const context& cx, const std::vector<fs::path>& files,
                             const fs::path& files_root, const fs::path& dest_file,
-                            flags f)
+                            compression c, std::size_t threads, flags f)
     {
         check(cx, dest_file, f);
 
@@ -540,7 +668,7 @@ namespace mob::op {
         if (conf().global().dry())
             return;
 
-        archiver::create_from_files(cx, dest_file, files, files_root);
+        archiver::create_from_files(cx, dest_file, files, files_root, c, threads);
     }
 
     void do_touch(const context& cx, const fs::path& p)
@@ -93,11 +93,26 @@ namespace mob::op {
     void copy_file_to_file_if_better(const context& cx, const fs::path& src_file,
                                      const fs::path& dest_file, flags f = noflags);
 
-    // basically calls copy_file_to_dir_if_better() for every file matching the
-    // glob; recursive
+    // returned by copy_glob_to_dir_if_better()
     //
-    void copy_glob_to_dir_if_better(const context& cx, const fs::path& src_glob,
-                                    const fs::path& dest_dir, flags f);
+    struct copy_stats {
+        // files that were copied and their total size
+        std::size_t copied   = 0;
+        std::uintmax_t bytes = 0;
+
+        // files that were already up to date
+        std::size_t skipped = 0;
+    };
+
+    // copies every file matching the glob to `dest_dir` if it's better, like
+    // copy_file_to_dir_if_better(), and directories recursively
+    //
+    // both sides are enumerated once with walk_directory() and compared in
+    // memory, then the files are copied in batches on a thread pool, which is
+    // much faster for directories with lots of small files
+    //
+    copy_stats copy_glob_to_dir_if_better(const context& cx, const fs::path& src_glob,
+                                          const fs::path& dest_dir, flags f);
 
     // renames `dest` to `src`, deleting `src` if it exists; if `backup` is given,
     // `src` is first renamed to it
@@ -123,17 +138,20 @@ namespace mob::op {
     // creates an archive `dest_file` and puts all the files matching `src_glob`
     // into it, ignoring any file in `ignore` by name
     //
-    // uses tools::archiver
+    // uses tools::archiver, `c` and `threads` are forwarded to it
     //
     void archive_from_glob(const context& cx, const fs::path& src_glob,
                            const fs::path& dest_file,
-                           const std::vector<std::string>& ignore, flags f = noflags);
+                           const std::vector<std::string>& ignore,
+                           compression c       = compression::normal,
+                           std::size_t threads = 0, flags f = noflags);
 
     // creates an archive `dest_file` and puts all the files from `files` in it,
     // resolving relative paths against `files_root`
     //
     void archive_from_files(const context& cx, const std::vector<fs::path>& files,
                             const fs::path& files_root, const fs::path& dest_file,
-                            flags f = noflags);
+                            compression c       = compression::normal,
+                            std::size_t threads = 0, flags f = noflags);
 
 }  // namespace mob::op
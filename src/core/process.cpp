@@ -528,6 +528,11 @@ namespace mob {
         return static_cast<int>(exec_.code);
     }
 
+    std::string process::command_line() const
+    {
+        return make_cmd();
+    }
+
     std::string process::stdout_string()
     {
         return io_.out.buffer.utf8_string();
@@ -329,6 +329,11 @@ namespace mob {
         //
         int exit_code() const;
 
+        // the command line that run() would execute, without the cwd or the
+        // environment
+        //
+        std::string command_line() const;
+
         // content of stdout/stderr if keep_in_string is set
         //
         std::string stdout_string();
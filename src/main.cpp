@@ -84,6 +84,9 @@ namespace mob {
             .add_task<mo>({"modorganizer-preview_dds", "ddspreview"})
             .add_task<mo>({"modorganizer", "organizer"});
 
+        // only enabled with [cmake] superbuild, builds all the projects above
+        add_task<superbuild>();
+
         // other tasks
         add_task<translations>();
         add_task<installer>();
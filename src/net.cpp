@@ -73,6 +73,29 @@ namespace mob {
             return path.substr(pos + 1);
     }
 
+    bool can_connect(const std::string& host_port, std::chrono::milliseconds timeout)
+    {
+        auto* c = curl_easy_init();
+        guard g([&] {
+            curl_easy_cleanup(c);
+        });
+
+        // the scheme is irrelevant, curl only connects
+        const std::string u = "http://" + host_port;
+
+        curl_easy_setopt(c, CURLOPT_URL, u.c_str());
+        curl_easy_setopt(c, CURLOPT_CONNECT_ONLY, 1l);
+        curl_easy_setopt(c, CURLOPT_CONNECTTIMEOUT_MS,
+                         static_cast<long>(timeout.count()));
+
+        const auto r = curl_easy_perform(c);
+
+        gcx().trace(context::net, "curl: connecting to {}: {}", host_port,
+                    curl_easy_strerror(r));
+
+        return (r == CURLE_OK);
+    }
+
     curl_downloader::curl_downloader(const context* cx)
         : cx_(cx ? *cx : gcx()), bytes_(0), interrupt_(false), ok_(false)
     {
@@ -38,6 +38,11 @@ namespace mob {
         std::string s_;
     };
 
+    // whether a tcp connection can be opened to `host_port`, such as
+    // "localhost:3632", within the given timeout; nothing is sent
+    //
+    bool can_connect(const std::string& host_port, std::chrono::milliseconds timeout);
+
     // threaded downloader
     //
     class curl_downloader {
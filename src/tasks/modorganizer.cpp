@@ -1,10 +1,16 @@
 #include "pch.h"
+#include "task_manager.h"
 #include "tasks.h"
 
+// preset used by all MO projects
+static constexpr auto cmakePreset = "vs2022-windows";
+
 #ifdef __unix__
 static constexpr auto defaultGenerator = mob::cmake::generators::ninjaMultiConfig;
+static constexpr auto installTarget    = "install";
 #else
 static constexpr auto defaultGenerator = mob::cmake::generators::vs;
+static constexpr auto installTarget    = "INSTALL";
 #endif
 
 namespace mob::tasks {
@@ -65,6 +71,36 @@ namespace mob::tasks {
         g.init_repo();
     }
 
+    // lists the remote branches of all the enabled modorganizer tasks in one go,
+    // used for mo_fallback
+    //
+    // every task checks its own branch in do_fetch(), but they'd each run
+    // ls-remote on demand; this fills git_remote_refs concurrently for everybody
+    // the first time a task needs it, the others block on the once_flag and then
+    // hit the cache
+    //
+    void prefetch_remote_branches(context& cx)
+    {
+        static std::once_flag once;
+
+        std::call_once(once, [&] {
+            std::vector<mob::url> urls;
+
+            for (const auto* t : task_manager::instance().find("super")) {
+                if (!t->enabled())
+                    continue;
+
+                if (const auto* o = dynamic_cast<const modorganizer*>(t))
+                    urls.push_back(o->git_url());
+            }
+
+            cx.trace(context::generic, "listing remote branches for {} repos",
+                     urls.size());
+
+            git_remote_refs::instance().prefetch(urls);
+        });
+    }
+
     modorganizer::modorganizer(std::string long_name)
         : modorganizer(std::vector<std::string>{long_name})
     {
@@ -142,22 +178,99 @@ namespace mob::tasks {
         // find the best suitable branch
         const auto fallback = task_conf().mo_fallback_branch();
         auto branch         = task_conf().mo_branch();
-        if (!fallback.empty() && !git_wrap::remote_branch_exists(git_url(), branch)) {
-            cx().warning(context::generic,
-                         "{} has no remote {} branch, switching to {}", repo_, branch,
-                         fallback);
-            branch = fallback;
+
+        if (!fallback.empty()) {
+            prefetch_remote_branches(cx());
+
+            if (!git_wrap::remote_branch_exists(git_url(), branch)) {
+                cx().warning(context::generic,
+                             "{} has no remote {} branch, switching to {}", repo_,
+                             branch, fallback);
+                branch = fallback;
+            }
         }
 
         // clone/pull
         run_tool(make_git().url(git_url()).branch(branch).root(source_path()));
     }
 
+    void modorganizer::generate()
+    {
+        cmake generate_tool(cmake::generate);
+
+        generate_tool.generator(defaultGenerator)
+            .configuration_types({task_conf().configuration()})
+            .preset(cmakePreset)
+            .root(source_path());
+
+        for (auto&& [name, value] : cmake_definitions())
+            generate_tool.def(name, "\"" + value + "\"");
+
+        run_tool(generate_tool);
+    }
+
+    std::string modorganizer::get_build_state()
+    {
+        // the superbuild task builds everything in one go, the projects can't be
+        // skipped individually
+        if (conf().cmake().superbuild())
+            return {};
+
+        return current_state();
+    }
+
+    std::string modorganizer::current_state()
+    {
+        git_wrap g(source_path());
+
+        if (!g.is_git_repo())
+            return {};
+
+        // local changes can't be tracked by the commit, so always build; .ts
+        // files are regenerated by the build itself and untracked files are
+        // ignored, or no repo would ever be up to date
+        if (g.has_source_changes()) {
+            cx().debug(context::generic, "{} has uncommitted changes", repo_);
+            return {};
+        }
+
+        return g.head_commit();
+    }
+
+    bool modorganizer::changed_since_install()
+    {
+        const auto state = current_state();
+
+        // uncommitted changes or not cloned yet
+        if (state.empty())
+            return true;
+
+        return (state != installed_build_state());
+    }
+
+    std::string modorganizer::preset()
+    {
+        return cmakePreset;
+    }
+
+    std::vector<std::pair<std::string, std::string>>
+    modorganizer::cmake_definitions() const
+    {
+        const auto tc = task_conf();
+
+        return {
+            {"CMAKE_INSTALL_PREFIX:PATH", path_to_utf8(conf().path().install())},
+            {"CMAKE_PREFIX_PATH", cmake_prefix_path()},
+            {"CMAKE_UNITY_BUILD", tc.unity_build() ? "ON" : "OFF"},
+            {"CMAKE_UNITY_BUILD_BATCH_SIZE", std::to_string(tc.unity_batch_size())},
+            {"CMAKE_DISABLE_PRECOMPILE_HEADERS",
+             tc.precompiled_headers() ? "OFF" : "ON"}};
+    }
+
     void modorganizer::do_build_and_install()
     {
-        // adds a git submodule in build for this project; note that
-        // git_submodule_adder runs a thread because adding submodules is slow, but
-        // can happen while stuff is building
+        // adds a git submodule in build for this project; git_submodule_adder adds
+        // all of them at once at the end of the build
         git_submodule_adder::instance().queue(
             std::move(git_submodule()
                           .url(git_url())
@@ -181,30 +294,175 @@ namespace mob::tasks {
                            "{} has no CMakePresets.txt, aborting build", repo_);
         }
 
+        // built by the superbuild task with all the other projects
+        if (conf().cmake().superbuild()) {
+            cx().debug(context::generic, "superbuild is enabled, not building");
+            return;
+        }
+
         // run cmake
-        run_tool(cmake(cmake::generate)
-                     .generator(defaultGenerator)
-                     .def("CMAKE_INSTALL_PREFIX:PATH", conf().path().install())
-                     .def("CMAKE_PREFIX_PATH", cmake_prefix_path())
-                     .configuration_types({task_conf().configuration()})
-                     .preset("vs2022-windows")
-                     .root(source_path()));
-
-        // run cmake --build with default target
+        generate();
+
+        // the install target depends on everything else, so building it directly
+        // builds and installs in one pass, the build graph is only scanned once;
+        // install_changed_only needs the build without the install
+        const bool combined =
+            task_conf().combined_install() && !task_conf().install_changed_only();
+
+        fs::path build_path = cmake(cmake::build).root(source_path()).build_path();
+
+        // only the steps of this build are reported
+        const auto log_mark = build_timings::mark(build_path);
+
         // TODO: handle rebuild by adding `--clean-first`
-        // TODO: have a way to specify the `--parallel` value - 16 is useful to build
-        // game_bethesda that has 15 games, so 15 projects
-        run_tool(cmake(cmake::build)
-                     .root(source_path())
-                     .arg("--parallel")
-                     .arg("16")
-                     .configuration(task_conf().configuration()));
+        // 16 is useful to build game_bethesda that has 15 games, so 15 projects,
+        // more when compiling on remote hosts
+        build_loop(
+            cx(), cmake::distributed_jobs().value_or(16),
+            build_path / "mob_flaky_targets.txt",
+            [&](int jobs, const std::vector<std::string>& targets) {
+                cmake build_tool(cmake::build);
+
+                build_tool.root(source_path())
+                    .arg("--parallel")
+                    .arg(std::to_string(jobs))
+                    .configuration(task_conf().configuration())
+                    .allow_failure();
+
+                // default target, or only the ones that failed last time
+                if (!targets.empty())
+                    build_tool.targets(targets);
+                else if (combined)
+                    build_tool.targets(installTarget);
+
+                build_path = run_tool(build_tool);
+
+                return build_result{build_tool.exit_code() == 0,
+                                    build_tool.failed_targets()};
+            });
+
+        if (combined) {
+            build_timings::instance().add(cx(), name(), build_path, log_mark);
+            update_manifest(read_cmake_manifest(build_path));
+
+            return;
+        }
+
+        // before installing, the install target adds its own build to the log
+        build_timings::instance().add(cx(), name(), build_path, log_mark);
+
+        if (task_conf().install_changed_only()) {
+            install_changed(build_path);
+        }
+        else {
+            // run cmake --install
+            run_tool(cmake(cmake::build)
+                         .root(source_path())
+                         .targets(installTarget)
+                         .configuration(task_conf().configuration()));
+
+            update_manifest(read_cmake_manifest(build_path));
+        }
+    }
+
+    std::vector<fs::path>
+    modorganizer::read_cmake_manifest(const fs::path& build_path)
+    {
+        // cmake writes the list of all the files it installed in the build
+        // directory, one absolute path per line
+        const auto file = build_path / "install_manifest.txt";
+
+        if (!exists(file)) {
+            cx().debug(context::generic, "{} not found, no install manifest", file);
+            return {};
+        }
+
+        std::vector<fs::path> files;
+
+        for_each_line(op::read_text_file(cx(), encodings::utf8, file),
+                      [&](auto&& line) {
+                          files.emplace_back(utf8_to_utf16(line));
+                      });
+
+        return files;
+    }
+
+    install_manifest modorganizer::update_manifest(const std::vector<fs::path>& files)
+    {
+        const auto old = install_manifest::load(cx(), manifest_path());
+        auto m = install_manifest::from_files(cx(), conf().path().install(), files);
+
+        report_changes(m, old);
+        m.save(cx(), manifest_path());
+
+        return m;
+    }
+
+    void modorganizer::report_changes(const install_manifest& m,
+                                      const install_manifest& old)
+    {
+        const auto changed = m.changed_since(old);
+        const auto removed = m.removed_since(old);
+
+        if (changed.empty() && removed.empty()) {
+            cx().info(context::generic, "installed files unchanged ({} files)",
+                      m.entries().size());
+
+            return;
+        }
+
+        cx().info(context::generic, "{} of {} installed files changed, {} removed",
+                  changed.size(), m.entries().size(), removed.size());
+
+        for (auto&& p : changed)
+            cx().debug(context::generic, "  changed: {}", p);
+
+        for (auto&& p : removed)
+            cx().debug(context::generic, "  removed: {}", p);
+    }
+
+    void modorganizer::install_changed(const fs::path& build_path)
+    {
+        // installs into a staging directory inside the build directory, cmake
+        // skips files that are already up to date in there, then copies the files
+        // whose content changed since the last install
+        const auto staging = build_path / "mob_staging";
 
-        // run cmake --install
-        run_tool(cmake(cmake::build)
+        run_tool(cmake(cmake::install)
                      .root(source_path())
-                     .targets("INSTALL")
+                     .prefix(staging)
                      .configuration(task_conf().configuration()));
+
+        // staging is never cleared and may still have files that the project
+        // doesn't install anymore, so only the files from this install are used
+        const auto staged = read_cmake_manifest(build_path);
+
+        const auto old = install_manifest::load(cx(), manifest_path());
+        const auto m   = install_manifest::from_files(cx(), staging, staged);
+
+        report_changes(m, old);
+
+        // changed files, but also files that were deleted from the install
+        // directory since the last time
+        const auto changed = m.changed_since(old);
+        const std::set<fs::path> changed_set(changed.begin(), changed.end());
+
+        std::size_t copied = 0;
+
+        for (auto&& e : m.entries()) {
+            const auto dest = conf().path().install() / e.path;
+
+            if (!changed_set.contains(e.path) && exists(dest))
+                continue;
+
+            op::copy_file_to_file_if_better(cx(), staging / e.path, dest);
+            ++copied;
+        }
+
+        cx().debug(context::generic, "copied {} files to {}", copied,
+                   conf().path().install());
+
+        m.save(cx(), manifest_path());
     }
 
 }  // namespace mob::tasks
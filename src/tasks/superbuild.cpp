@@ -0,0 +1,236 @@
+#include "pch.h"
+#include "task_manager.h"
+#include "tasks.h"
+
+namespace mob::tasks {
+
+    namespace {
+
+        // cmake bracket argument, the content is used verbatim so paths and
+        // definitions don't need escaping
+        //
+        std::string bracket(std::string s)
+        {
+            std::replace(s.begin(), s.end(), '\\', '/');
+            return "[==[" + s + "]==]";
+        }
+
+        // total number of jobs for the superbuild, the projects that build at
+        // the same time share it
+        //
+        int job_budget()
+        {
+            return cmake::distributed_jobs().value_or(
+                static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)));
+        }
+
+        // first line of the generated CMakeLists.txt
+        //
+        constexpr auto generated_header =
+            "# generated by mob when superbuild is set in [cmake], do not edit\n";
+
+    }  // namespace
+
+    superbuild::superbuild() : task("superbuild") {}
+
+    bool superbuild::enabled() const
+    {
+        return conf().cmake().superbuild();
+    }
+
+    bool superbuild::changed_since_install()
+    {
+        return true;
+    }
+
+    void superbuild::do_build_and_install()
+    {
+        const auto v = projects();
+
+        if (v.empty()) {
+            cx().info(context::generic, "no projects to build");
+            return;
+        }
+
+        // generated outside of modorganizer_super so it doesn't show up in the
+        // repo or in the source archive of releases
+        const auto root = conf().path().build() / "superbuild";
+        const auto file = root / "CMakeLists.txt";
+        const auto text = make_cmakelists(v);
+
+        remove_old_cmakelists();
+
+        op::create_directories(cx(), root);
+
+        // only written when it changes so cmake doesn't have to regenerate
+        if (!exists(file) ||
+            op::read_text_file(cx(), encodings::utf8, file, op::optional) != text) {
+            op::write_text_file(cx(), encodings::utf8, file, text);
+        }
+
+        run_tool(cmake(cmake::generate)
+                     .configuration_types({task_conf().configuration()})
+                     .root(root));
+
+        // only the steps of this build are reported
+        std::map<modorganizer*, build_timings::log_mark> log_marks;
+
+        for (auto&& stage : v) {
+            for (auto* mo : stage) {
+                log_marks[mo] = build_timings::mark(
+                    cmake(cmake::build).root(mo->source_path()).build_path());
+            }
+        }
+
+        // each project already gets its share of the budget, see
+        // make_cmakelists(), this limits how many of them run at the same time
+        run_tool(cmake(cmake::build)
+                     .root(root)
+                     .arg("--parallel")
+                     .arg(std::to_string(job_budget()))
+                     .configuration(task_conf().configuration()));
+
+        for (auto&& stage : v) {
+            for (auto* mo : stage) {
+                build_timings::instance().add(
+                    cx(), mo->name(),
+                    cmake(cmake::build).root(mo->source_path()).build_path(),
+                    log_marks[mo]);
+            }
+        }
+    }
+
+    void superbuild::remove_old_cmakelists()
+    {
+        // older versions generated the CMakeLists.txt in modorganizer_super,
+        // only deleted if it's still the generated one
+        const auto old = modorganizer::super_path() / "CMakeLists.txt";
+
+        if (!exists(old))
+            return;
+
+        const auto text = op::read_text_file(cx(), encodings::utf8, old, op::optional);
+
+        if (text.starts_with(generated_header)) {
+            cx().debug(context::generic, "deleting old {}", old);
+            op::delete_file(cx(), old, op::optional);
+        }
+    }
+
+    std::vector<std::vector<modorganizer*>> superbuild::projects() const
+    {
+        auto& tm = task_manager::instance();
+        std::vector<std::vector<modorganizer*>> v;
+
+        for (auto* top : tm.top_level()) {
+            std::vector<modorganizer*> stage;
+
+            for (auto* t : tm.top_level_children(top)) {
+                auto* mo = dynamic_cast<modorganizer*>(t);
+
+                if (!mo || !mo->enabled() || !tm.is_affected(mo))
+                    continue;
+
+                // such as cmake_common, see modorganizer::do_build_and_install()
+                if (!exists(mo->source_path() / "CMakeLists.txt"))
+                    continue;
+
+                stage.push_back(mo);
+            }
+
+            if (!stage.empty())
+                v.push_back(std::move(stage));
+        }
+
+        return v;
+    }
+
+    std::string superbuild::make_cmakelists(
+        const std::vector<std::vector<modorganizer*>>& projects) const
+    {
+        std::string s =
+            std::string(generated_header) +
+            "cmake_minimum_required(VERSION 3.21)\n"
+            "project(modorganizer_super NONE)\n"
+            "\n"
+            "include(ExternalProject)\n";
+
+        // same environment as cmake::do_generate()
+        const std::string env =
+            bracket("VCPKG_ROOT=" + path_to_utf8(absolute(conf().path().vcpkg()))) +
+            " " + bracket("CXXFLAGS=/wd4566");
+
+        // the projects of a stage are built at the same time, each one gets a
+        // share of the jobs so the machine isn't oversubscribed
+        const int budget = job_budget();
+
+        // projects from the previous top level task, everything in a top level
+        // task depends on the ones before it
+        std::vector<std::string> previous;
+
+        for (auto&& stage : projects) {
+            std::vector<std::string> current;
+
+            const auto jobs =
+                std::max(1, budget / static_cast<int>(stage.size()));
+
+            for (auto* mo : stage) {
+                const auto config =
+                    cmake::config_name(conf().task(mo->names()).configuration());
+
+                const auto src = bracket(path_to_utf8(mo->source_path()));
+
+                // same build directory as modorganizer::do_build_and_install()
+                const auto bin = bracket(path_to_utf8(
+                    cmake(cmake::build).root(mo->source_path()).build_path()));
+
+                s += std::format("\n"
+                                 "ExternalProject_Add({}\n"
+                                 "    SOURCE_DIR {}\n"
+                                 "    BINARY_DIR {}\n"
+                                 "    DOWNLOAD_COMMAND \"\"\n"
+                                 "    UPDATE_COMMAND \"\"\n"
+                                 "    CONFIGURE_COMMAND ${{CMAKE_COMMAND}} -E env {}\n"
+                                 "        ${{CMAKE_COMMAND}} -S {} --preset {}\n"
+                                 "        {}\n",
+                                 mo->name(), src, bin, env, src, modorganizer::preset(),
+                                 bracket("-DCMAKE_CONFIGURATION_TYPES=" + config));
+
+                auto defs          = cmake::common_definitions();
+                const auto mo_defs = mo->cmake_definitions();
+                defs.insert(defs.end(), mo_defs.begin(), mo_defs.end());
+
+                // lists like CMAKE_PREFIX_PATH would be split on the semicolons,
+                // see LIST_SEPARATOR below
+                for (auto&& [name, value] : defs) {
+                    s += "        " +
+                         bracket("-D" + name + "=" + replace_all(value, ";", "|")) +
+                         "\n";
+                }
+
+                for (auto&& name : cmake::common_undefinitions())
+                    s += "        " + bracket("-U" + name) + "\n";
+
+                s += std::format(
+                    "    BUILD_COMMAND ${{CMAKE_COMMAND}} --build {} --config {} "
+                    "--parallel {}\n"
+                    "    INSTALL_COMMAND ${{CMAKE_COMMAND}} --install {} --config {}\n"
+                    "    LIST_SEPARATOR |\n"
+                    "    BUILD_ALWAYS TRUE\n",
+                    bin, config, jobs, bin, config);
+
+                if (!previous.empty())
+                    s += "    DEPENDS " + join(previous, " ") + "\n";
+
+                s += ")\n";
+
+                current.push_back(mo->name());
+            }
+
+            previous = std::move(current);
+        }
+
+        return s;
+    }
+
+}  // namespace mob::tasks
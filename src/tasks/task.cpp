@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "task.h"
 #include "../core/conf.h"
+#include "../core/manifest.h"
 #include "../core/op.h"
 #include "../tools/tools.h"
 #include "../utility/threading.h"
@@ -65,6 +66,11 @@ namespace mob {
         return c;
     }
 
+    // see task::set_dependencies_stamp()
+    //
+    static std::string g_dependencies_stamp;
+    static std::mutex g_dependencies_stamp_mutex;
+
     task::task(std::vector<std::string> names)
         : names_(std::move(names)), bailed_(), interrupted_(false)
     {
@@ -296,6 +302,9 @@ namespace mob {
         g.revert_ts_on_pull(task_conf().revert_ts());
         g.credentials(task_conf().git_user(), task_conf().git_email());
         g.shallow(task_conf().git_shallow());
+        g.mirror(task_conf().git_mirror());
+        g.filter(task_conf().git_filter());
+        g.sparse(task_conf().git_sparse());
 
         if (task_conf().set_origin_remote()) {
             g.remote(task_conf().remote_org(), task_conf().remote_key(),
@@ -333,6 +342,11 @@ namespace mob {
                 return;
             }
 
+            if (!task_manager::instance().is_affected(this)) {
+                cx().debug(context::generic, "task is not affected, skipping");
+                return;
+            }
+
             cx().info(context::generic, "running task");
 
             // clean task if needed
@@ -404,11 +418,158 @@ namespace mob {
             return;
         }
 
+        const auto stamp = make_build_stamp();
+
+        if (!stamp.empty() && stamp == installed_stamp()) {
+            if (installed_files_exist()) {
+                cx().info(context::generic, "up to date, skipping build and install");
+                return;
+            }
+
+            cx().info(context::generic, "up to date, but installed files are missing");
+        }
+
+        // the old stamp must not survive a build that fails or that can't have a
+        // stamp, such as one with uncommitted changes, or the task would be
+        // skipped later even though something else was installed, and tasks
+        // that depend on it wouldn't see the change
+        op::delete_file(cx(), stamp_path(), op::optional);
+
         cx().info(context::generic, "build and install");
         do_build_and_install();
+
+        if (!stamp.empty()) {
+            op::create_directories(cx(), stamp_path().parent_path());
+            op::write_text_file(cx(), encodings::utf8, stamp_path(), stamp);
+        }
+
         cx().info(context::generic, "done");
     }
 
+    std::string task::make_build_stamp()
+    {
+        if (!task_conf().skip_up_to_date())
+            return {};
+
+        // these are supposed to rebuild, whether anything changed or not
+        if (conf().global().clean()) {
+            const auto c = make_clean_flags();
+
+            if (is_set(c, clean::reextract) || is_set(c, clean::reconfigure) ||
+                is_set(c, clean::rebuild)) {
+                return {};
+            }
+        }
+
+        const auto state = get_build_state();
+        if (state.empty())
+            return {};
+
+        const auto options =
+            std::format("configuration={}\n"
+                        "unity_build={}\n"
+                        "unity_batch_size={}\n"
+                        "precompiled_headers={}\n"
+                        "combined_install={}\n"
+                        "install_changed_only={}\n",
+                        static_cast<int>(task_conf().configuration()),
+                        task_conf().unity_build(), task_conf().unity_batch_size(),
+                        task_conf().precompiled_headers(),
+                        task_conf().combined_install(),
+                        task_conf().install_changed_only()) +
+            options_string({"cmake", "paths", "versions"});
+
+        std::string deps;
+
+        {
+            std::scoped_lock lock(g_dependencies_stamp_mutex);
+            deps = g_dependencies_stamp;
+        }
+
+        return std::format("state: {}\n"
+                           "options: {}\n"
+                           "dependencies: {}\n",
+                           state, hash_string(options), deps);
+    }
+
+    fs::path task::stamp_path() const
+    {
+        return conf().path().build() / ".mob_stamps" / (name() + ".stamp");
+    }
+
+    bool task::installed_files_exist() const
+    {
+        const auto install = conf().path().install();
+        if (!fs::exists(install))
+            return false;
+
+        // paths are relative to the install directory, see
+        // modorganizer::update_manifest()
+        const auto m = install_manifest::load(cx(), manifest_path());
+
+        for (auto&& e : m.entries()) {
+            if (!fs::exists(install / e.path)) {
+                cx().debug(context::generic, "{} is missing", install / e.path);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    fs::path task::manifest_path() const
+    {
+        return conf().path().build() / ".mob_stamps" / (name() + ".manifest");
+    }
+
+    std::string task::dependency_stamp() const
+    {
+        const auto m = install_manifest::load(gcx(), manifest_path());
+        if (!m.empty())
+            return m.hash();
+
+        return installed_stamp();
+    }
+
+    std::string task::installed_stamp() const
+    {
+        const auto p = stamp_path();
+        if (!fs::exists(p))
+            return {};
+
+        return op::read_text_file(gcx(), encodings::utf8, p, op::optional);
+    }
+
+    std::string task::installed_build_state() const
+    {
+        const auto stamp = installed_stamp();
+        std::string state;
+
+        // first line of the stamp, see make_build_stamp()
+        for_each_line(stamp, [&](auto&& line) {
+            if (state.empty() && line.starts_with("state: "))
+                state = std::string(line.substr(7));
+        });
+
+        return state;
+    }
+
+    bool task::changed_since_install()
+    {
+        return false;
+    }
+
+    void task::set_dependencies_stamp(std::string s)
+    {
+        std::scoped_lock lock(g_dependencies_stamp_mutex);
+        g_dependencies_stamp = std::move(s);
+    }
+
+    std::string task::get_build_state()
+    {
+        return {};
+    }
+
     void task::check_bailed()
     {
         if (bailed_)
@@ -93,6 +93,33 @@ namespace mob {
         //
         virtual void check_bailed();
 
+        // returns the stamp saved after this task was last built and installed,
+        // or an empty string if there isn't one; see build_and_install()
+        //
+        std::string installed_stamp() const;
+
+        // returns what tasks that run after this one use as the dependency
+        // stamp: the hash of the install manifest if the task has one, so
+        // dependents are only rebuilt when the installed files actually
+        // changed, or installed_stamp() otherwise
+        //
+        std::string dependency_stamp() const;
+
+        // whether the source of this task changed since it was last installed,
+        // used by `mob build --affected`
+        //
+        // returns false here, tasks that can't tell are only considered changed
+        // when something they depend on was
+        //
+        virtual bool changed_since_install();
+
+        // sets the combined stamps of all the tasks that run before the current
+        // ones, called by the task_manager before running each top level task;
+        // this is part of every stamp so tasks are built again when something
+        // they depend on was
+        //
+        static void set_dependencies_stamp(std::string s);
+
     protected:
         using parallel_functions =
             std::vector<std::pair<std::string, std::function<void()>>>;
@@ -120,6 +147,15 @@ namespace mob {
         //
         virtual void do_build_and_install();
 
+        // implemented by derived classes that can be skipped when they're up to
+        // date, returns whatever identifies the state of the source, such as the
+        // commit for git repos
+        //
+        // returns an empty string if the task can't tell, in which case it's
+        // always built; this is the default
+        //
+        virtual std::string get_build_state();
+
         // returns the task's context
         //
         // since a task may be running several threads, a list of per-thread context
@@ -173,6 +209,15 @@ namespace mob {
         //
         std::string make_git_url(const std::string& org, const std::string& repo) const;
 
+        // path of the install manifest for this task, see install_manifest
+        //
+        fs::path manifest_path() const;
+
+        // returns the build state saved in the stamp when this task was last
+        // installed, see get_build_state(); empty if there's no stamp
+        //
+        std::string installed_build_state() const;
+
     private:
         // names for this task
         const std::vector<std::string> names_;
@@ -238,8 +283,28 @@ namespace mob {
         // calls do_build_and_install() if building is enabled
         // (see --no-build-task); no-op if the task is disabled
         //
+        // if skip_up_to_date is set and the stamp for the task hasn't changed
+        // since the last time it was built, do_build_and_install() is not called;
+        // the stamp is saved after a successful build
+        //
         void build_and_install();
 
+        // returns the stamp for the current state of the task: the build state,
+        // the relevant options and the dependencies; empty if the task doesn't
+        // support stamps
+        //
+        std::string make_build_stamp();
+
+        // path to the stamp file for this task
+        //
+        fs::path stamp_path() const;
+
+        // whether what was installed when the stamp was saved is still there:
+        // the install directory and every file in the install manifest, if the
+        // task has one
+        //
+        bool installed_files_exist() const;
+
         // calls do_clean() if needed with the appropriate flags (see
         // --no-clean-task); no-op if the task is disabled
         //
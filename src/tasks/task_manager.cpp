@@ -1,6 +1,9 @@
 #include "pch.h"
 #include "task_manager.h"
+#include "../core/conf.h"
 #include "../core/context.h"
+#include "../core/ninja_log.h"
+#include "../tools/tools.h"
 #include "task.h"
 
 namespace mob {
@@ -89,14 +92,128 @@ namespace mob {
         return aliases_;
     }
 
+    std::vector<task*> task_manager::dependents(const std::vector<task*>& tasks)
+    {
+        std::vector<task*> v;
+        bool found = false;
+
+        for (auto&& t : top_level_) {
+            const auto children = top_level_children(t.get());
+
+            // everything after the first top-level task that has one of the
+            // given tasks depends on it
+            const bool had_found = found;
+
+            for (auto* c : children) {
+                const bool given = std::find(tasks.begin(), tasks.end(), c) !=
+                                   tasks.end();
+
+                if (had_found || given)
+                    v.push_back(c);
+
+                if (given)
+                    found = true;
+            }
+        }
+
+        return v;
+    }
+
+    void task_manager::set_affected_by(const std::vector<task*>& tasks)
+    {
+        affected_only_ = true;
+
+        for (auto* t : dependents(tasks))
+            affected_.insert(t);
+    }
+
+    void task_manager::set_affected_by_changes(bool b)
+    {
+        affected_by_changes_ = b;
+
+        if (b)
+            affected_only_ = true;
+    }
+
+    bool task_manager::is_affected(const task* t) const
+    {
+        if (!affected_only_)
+            return true;
+
+        return affected_.contains(t);
+    }
+
+    std::vector<task*> task_manager::top_level_children(task* t) const
+    {
+        if (auto* pt = dynamic_cast<parallel_tasks*>(t))
+            return pt->children();
+
+        return {t};
+    }
+
+    void task_manager::add_changed(task* t, bool upstream_changed)
+    {
+        for (auto* c : top_level_children(t)) {
+            if (!c->enabled() || affected_.contains(c))
+                continue;
+
+            if (upstream_changed) {
+                affected_.insert(c);
+            }
+            else if (c->changed_since_install()) {
+                gcx().info(context::generic, "{} changed since it was last installed",
+                           c->name());
+
+                affected_.insert(c);
+            }
+        }
+    }
+
     void task_manager::run_all()
     {
+        cmake::start_compiler_cache();
+        cmake::start_distributed();
+
         try {
+            // stamps of all the tasks that have run so far, see
+            // task::set_dependencies_stamp()
+            std::string deps;
+
+            // set when the installed files of a task changed, everything that
+            // runs after that is affected, see set_affected_by_changes()
+            bool upstream_changed = false;
+
             for (auto&& t : top_level_) {
+                if (interrupt_)
+                    break;
+
+                const auto children = top_level_children(t.get());
+
+                std::vector<std::string> before;
+
+                if (affected_by_changes_) {
+                    add_changed(t.get(), upstream_changed);
+
+                    for (auto* c : children)
+                        before.push_back(c->dependency_stamp());
+                }
+
+                task::set_dependencies_stamp(hash_string(deps));
                 t->run();
 
                 if (interrupt_)
                     break;
+
+                // disabled tasks still have the stamp from the last time they
+                // were built
+                for (std::size_t i = 0; i < children.size(); ++i) {
+                    const auto stamp = children[i]->dependency_stamp();
+
+                    if (!before.empty() && stamp != before[i])
+                        upstream_changed = true;
+
+                    deps += stamp;
+                }
             }
         }
         catch (interrupted&) {
@@ -105,6 +222,15 @@ namespace mob {
         for (auto&& t : top_level_) {
             t->check_bailed();
         }
+
+        if (interrupt_)
+            return;
+
+        cmake::report_compiler_cache();
+        build_timings::instance().report(gcx());
+
+        // adds the submodules that were queued by the tasks
+        git_submodule_adder::instance().stop();
     }
 
     void task_manager::interrupt_all()
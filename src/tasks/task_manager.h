@@ -63,8 +63,44 @@ namespace mob {
         //
         const alias_map& aliases();
 
+        // returns the given tasks followed by all the tasks that depend on them,
+        // in the order in which they run
+        //
+        // dependencies are not declared anywhere, they're given by the order in
+        // which top-level tasks are added: a task depends on everything in the
+        // top-level tasks before it, but not on the other children of its own
+        // parallel_tasks
+        //
+        std::vector<task*> dependents(const std::vector<task*>& tasks);
+
+        // run_all() will only run the given tasks and their dependents, see
+        // dependents(); used by `mob build --affected-by`
+        //
+        void set_affected_by(const std::vector<task*>& tasks);
+
+        // run_all() will only run tasks that changed since they were last
+        // installed, see task::changed_since_install(), along with everything
+        // that runs after a task whose installed files changed; used by
+        // `mob build --affected`
+        //
+        void set_affected_by_changes(bool b);
+
+        // whether run_all() should run the given task, always true unless one of
+        // the set_affected_*() functions above was called
+        //
+        bool is_affected(const task* t) const;
+
+        // returns the children of a parallel_tasks, or the task itself
+        //
+        std::vector<task*> top_level_children(task* t) const;
+
         // runs all top-level tasks sequentially, disabled tasks won't run
         //
+        // sets up the compiler cache and distributed compilation before running
+        // anything, then reports the cache statistics and the build timings and
+        // adds the submodules queued by the tasks once everything has run, so
+        // both `mob build` and `mob release official` get them
+        //
         void run_all();
 
         // interrupts all tasks
@@ -87,6 +123,22 @@ namespace mob {
         // alias map
         alias_map aliases_;
 
+        // set by set_affected_*(), is_affected() returns true for everything
+        // when both are false
+        bool affected_only_       = false;
+        bool affected_by_changes_ = false;
+
+        // tasks that should run when affected_only_ is set; filled by
+        // set_affected_by() and by run_all() before starting each top-level task
+        // when affected_by_changes_ is set, which is why it's not locked
+        std::set<const task*> affected_;
+
+        // called by run_all() before running the given top-level task when
+        // affected_by_changes_ is set, adds the tasks that changed, or all of them
+        // if `upstream_changed` is true, to affected_
+        //
+        void add_changed(task* t, bool upstream_changed);
+
         // used by find(), returns tasks matching the given glob
         //
         std::vector<task*> find_by_pattern(std::string_view pattern);
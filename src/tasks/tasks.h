@@ -1,6 +1,8 @@
 #pragma once
 
 #include "../core/conf.h"
+#include "../core/manifest.h"
+#include "../core/ninja_log.h"
 #include "../core/op.h"
 #include "../net.h"
 #include "../tools/tools.h"
@@ -122,14 +124,98 @@ namespace mob::tasks {
         //
         fs::path source_path() const;
 
+        // true when the repo has uncommitted changes or its commit is not the
+        // one that was last installed
+        //
+        bool changed_since_install() override;
+
+        // cmake preset used to generate all projects
+        //
+        static std::string preset();
+
+        // definitions given to cmake when generating this project, as name/value
+        // pairs; also used by the superbuild task
+        //
+        std::vector<std::pair<std::string, std::string>> cmake_definitions() const;
+
     protected:
         void do_clean(clean c) override;
         void do_fetch() override;
         void do_build_and_install() override;
+        std::string get_build_state() override;
 
     private:
         std::string repo_;
         std::string project_;
+
+        // runs cmake to generate the build files
+        //
+        void generate();
+
+        // returns the files listed in the install_manifest.txt that cmake
+        // creates in the build directory
+        //
+        std::vector<fs::path> read_cmake_manifest(const fs::path& build_path);
+
+        // builds a manifest for the given installed files, reports what changed
+        // since the last install and saves it
+        //
+        install_manifest update_manifest(const std::vector<fs::path>& files);
+
+        // logs the files that changed between the two manifests
+        //
+        void report_changes(const install_manifest& m, const install_manifest& old);
+
+        // for install_changed_only: installs into a staging directory and only
+        // copies the files that changed to the install directory
+        //
+        void install_changed(const fs::path& build_path);
+
+        // commit of the repo, or an empty string if it has uncommitted changes
+        // or isn't a repo; used by get_build_state()
+        //
+        std::string current_state();
+    };
+
+    // builds all the enabled MO projects in one cmake build when `superbuild` is
+    // set in [cmake], instead of one after the other in their own tasks
+    //
+    // generates a CMakeLists.txt in build/superbuild with an ExternalProject
+    // per project; each project depends on the ones that are in earlier top
+    // level tasks, so the build tool can run all the others at the same time
+    //
+    class superbuild : public task {
+    public:
+        superbuild();
+
+        // enabled when `superbuild` is set in [cmake], regardless of the task
+        // names given on the command line
+        //
+        bool enabled() const override;
+
+        // always true, the projects it builds are filtered by
+        // task_manager::is_affected()
+        //
+        bool changed_since_install() override;
+
+    protected:
+        void do_build_and_install() override;
+
+    private:
+        // deletes the CMakeLists.txt that older versions generated in
+        // modorganizer_super
+        //
+        void remove_old_cmakelists();
+
+        // enabled MO projects that have a CMakeLists.txt, grouped by top level
+        // task
+        //
+        std::vector<std::vector<modorganizer*>> projects() const;
+
+        // returns the content of the CMakeLists.txt for the given projects
+        //
+        std::string make_cmakelists(
+            const std::vector<std::vector<modorganizer*>>& projects) const;
     };
 
     class stylesheets : public task {
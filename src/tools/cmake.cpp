@@ -1,4 +1,5 @@
 #include "pch.h"
+#include "../core/manifest.h"
 #include "../core/process.h"
 #include "tools.h"
 
@@ -11,23 +12,121 @@ static constexpr auto defaultGenerator = mob::cmake::generators::vs;
 namespace mob {
 
     namespace {
-        std::string config_to_string(config c)
+        // stamp saved in the build directory by do_generate()
+        //
+        constexpr auto generate_stamp_file = "mob_generate.stamp";
+
+        // environment variables that can change the result of generating
+        //
+        bool affects_generate(std::string_view name)
+        {
+            static const std::set<std::string, std::less<>> names = {
+                "PATH", "INCLUDE", "LIB", "LIBPATH", "CC", "CXX", "CFLAGS",
+                "CXXFLAGS", "LDFLAGS", "VCPKG_ROOT", "QTDIR"};
+
+            return names.contains(name) || name.starts_with("CMAKE_");
+        }
+
+        // returns the target that failed if the given line of build output
+        // reports a failure, an empty string otherwise
+        //
+        std::string failed_target(std::string_view line)
         {
-            switch (c) {
-            case config::debug:
-                return "Debug";
-            case config::release:
-                return "Release";
-            case config::relwithdebinfo:
-                return "RelWithDebInfo";
+            // ninja: "FAILED: CMakeFiles/x.dir/a.cpp.o" or, since 1.12,
+            // "FAILED: [code=2] CMakeFiles/x.dir/a.cpp.o"; ninja can build an
+            // output file directly, only the first one is needed if there are
+            // many
+            if (line.starts_with("FAILED: ")) {
+                auto s = line.substr(8);
+
+                if (s.starts_with("[code=")) {
+                    const auto e = s.find("] ");
+                    if (e != std::string_view::npos)
+                        s = s.substr(e + 2);
+                }
+
+                return std::string(s.substr(0, s.find(' ')));
             }
-            gcx().bail_out(context::generic, "unknow configuration type {}", c);
+
+            // msbuild: "a.cpp(3): error C2065: ... [C:\build\x.vcxproj]" or
+            // "LINK : fatal error LNK1104: ... [C:\build\x.vcxproj]", the
+            // project has the name of the target
+            static const std::regex re(
+                "(fatal )?error [A-Z]+[0-9]+.*\\[([^\\[\\]]+)\\.vcxproj\\]$");
+
+            std::match_results<std::string_view::const_iterator> m;
+            if (std::regex_search(line.begin(), line.end(), m, re))
+                return path_to_utf8(fs::path(m[2].str()).filename());
+
+            return {};
+        }
+
+        // whether the given file is read by cmake when generating
+        //
+        bool is_cmake_input(const fs::path& p)
+        {
+            const auto name = path_to_utf8(p.filename());
+
+            return name == "CMakeLists.txt" || name == "CMakePresets.json" ||
+                   name == "CMakeUserPresets.json" || name == "vcpkg.json" ||
+                   name == "vcpkg-configuration.json" || p.extension() == ".cmake";
+        }
+
+#ifdef __unix__
+        // whether the linker is given --gdb-index with split_dwarf, an index so
+        // debuggers don't have to open every .dwo on startup; the default bfd
+        // linker doesn't support it
+        //
+        bool gdb_index()
+        {
+            auto linker = conf().cmake().linker();
+            std::transform(linker.begin(), linker.end(), linker.begin(), [](char c) {
+                return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            });
+
+            return conf().cmake().split_dwarf() && !linker.empty() && linker != "bfd";
+        }
+
+        // writes a file for CMAKE_PROJECT_INCLUDE that adds -gsplit-dwarf, and
+        // --gdb-index if supported, to RelWithDebInfo on top of whatever flags
+        // the project, a preset or a toolchain already has; written once per run
+        // in the build directory, returns its path
+        //
+        // the file name depends on the content so turning --gdb-index on or off
+        // changes the command line, see cmake::do_generate()
+        //
+        fs::path split_dwarf_include()
+        {
+            static std::once_flag once;
+
+            const auto file = conf().path().build() /
+                              (gdb_index() ? "mob_split_dwarf_gdb_index.cmake"
+                                           : "mob_split_dwarf.cmake");
+
+            std::call_once(once, [&] {
+                std::string s =
+                    "# generated by mob for split_dwarf in [cmake]\n"
+                    "include_guard(GLOBAL)\n"
+                    "add_compile_options(\"$<$<AND:$<CONFIG:RelWithDebInfo>,"
+                    "$<COMPILE_LANGUAGE:C,CXX>>:-gsplit-dwarf>\")\n";
+
+                if (gdb_index()) {
+                    s += "add_link_options("
+                         "\"$<$<CONFIG:RelWithDebInfo>:LINKER:--gdb-index>\")\n";
+                }
+
+                op::create_directories(gcx(), file.parent_path());
+                op::write_text_file(gcx(), encodings::utf8, file, s);
+            });
+
+            return file;
         }
+#endif
     }  // namespace
 
     cmake::cmake(ops o)
         : basic_process_runner("cmake"), op_(o), gen_(defaultGenerator),
-          arch_(arch::def)
+          arch_(arch::def), allow_failure_(false)
     {
     }
 
@@ -36,6 +135,283 @@ namespace mob {
         return conf().tool().get("cmake");
     }
 
+    std::string cmake::config_name(config c)
+    {
+        switch (c) {
+        case config::debug:
+            return "Debug";
+        case config::release:
+            return "Release";
+        case config::relwithdebinfo:
+            return "RelWithDebInfo";
+        }
+        gcx().bail_out(context::generic, "unknow configuration type {}", c);
+    }
+
+    std::vector<std::pair<std::string, std::string>> cmake::common_definitions()
+    {
+        std::vector<std::pair<std::string, std::string>> v;
+
+        v.emplace_back("CMAKE_INSTALL_MESSAGE",
+                       conf_cmake::to_string(conf().cmake().install_message()));
+
+        // compiler cache or distributed compiler, the launcher is ignored by the
+        // visual studio generators
+        //
+        // when both are set, the cache is the launcher and calls the distributed
+        // compiler on misses through CCACHE_PREFIX, see start_distributed(); the
+        // launcher never depends on whether the remote hosts are reachable so
+        // falling back to local builds doesn't change the generated files
+        auto launcher = conf().cmake().compiler_launcher();
+        if (launcher.empty())
+            launcher = conf().cmake().distributed_compiler();
+
+        // see common_undefinitions() when there's no launcher
+        if (!launcher.empty()) {
+            v.emplace_back("CMAKE_C_COMPILER_LAUNCHER", path_to_utf8(launcher));
+            v.emplace_back("CMAKE_CXX_COMPILER_LAUNCHER", path_to_utf8(launcher));
+        }
+
+#ifndef __unix__
+        if (!launcher.empty()) {
+            // /Zi shares a pdb between all the objects, which can't be cached;
+            // /Z7 embeds the debug information in the objects instead, see
+            // common_undefinitions()
+            v.emplace_back("CMAKE_POLICY_DEFAULT_CMP0141", "NEW");
+            v.emplace_back("CMAKE_MSVC_DEBUG_INFORMATION_FORMAT", "Embedded");
+        }
+#endif
+
+        // the linkers that cmake knows are named in uppercase, like MOLD
+        auto linker = conf().cmake().linker();
+        std::transform(linker.begin(), linker.end(), linker.begin(), [](char c) {
+            return static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        });
+
+        if (!linker.empty())
+            v.emplace_back("CMAKE_LINKER_TYPE", linker);
+
+#ifdef __unix__
+        // debug information goes in .dwo files that the linker never reads; the
+        // flags are added by an include instead of replacing the RelWithDebInfo
+        // flags in the cache, see common_undefinitions() when it's off
+        if (conf().cmake().split_dwarf()) {
+            v.emplace_back("CMAKE_PROJECT_INCLUDE",
+                           path_to_utf8(split_dwarf_include()));
+        }
+#endif
+
+        return v;
+    }
+
+    std::vector<std::string> cmake::common_undefinitions()
+    {
+        std::vector<std::string> v;
+
+        // an empty linker type is not the same as the default one
+        if (conf().cmake().linker().empty())
+            v.push_back("CMAKE_LINKER_TYPE");
+
+        // removing the launcher from the options also removes it from existing
+        // caches; an empty one would override a launcher given in the
+        // environment with CMAKE_<LANG>_COMPILER_LAUNCHER or in a preset
+        if (conf().cmake().compiler_launcher().empty() &&
+            conf().cmake().distributed_compiler().empty()) {
+            v.push_back("CMAKE_C_COMPILER_LAUNCHER");
+            v.push_back("CMAKE_CXX_COMPILER_LAUNCHER");
+        }
+
+#ifdef __unix__
+        // removes the include from existing caches when split_dwarf is turned
+        // off
+        if (!conf().cmake().split_dwarf())
+            v.push_back("CMAKE_PROJECT_INCLUDE");
+#endif
+
+#ifndef __unix__
+        // back to the debug information format of the project without a launcher
+        if (conf().cmake().compiler_launcher().empty() &&
+            conf().cmake().distributed_compiler().empty()) {
+            v.push_back("CMAKE_POLICY_DEFAULT_CMP0141");
+            v.push_back("CMAKE_MSVC_DEBUG_INFORMATION_FORMAT");
+        }
+#endif
+
+        return v;
+    }
+
+    void cmake::start_compiler_cache()
+    {
+        const auto launcher = conf().cmake().compiler_launcher();
+        if (launcher.empty())
+            return;
+
+        const auto dir = conf().path().compiler_cache();
+        op::create_directories(gcx(), dir);
+
+        // ccache and sccache each have their own variable, they're inherited by
+        // the compiler processes started by the build tools
+        this_env::set("CCACHE_DIR", path_to_utf8(dir));
+        this_env::set("SCCACHE_DIR", path_to_utf8(dir));
+
+        gcx().info(context::generic, "using {} as compiler launcher, cache in {}",
+                   launcher, dir);
+
+        // both ccache and sccache support these
+        process()
+            .binary(launcher)
+            .arg("--zero-stats")
+            .stdout_flags(process::bit_bucket)
+            .flags(process::allow_failure)
+            .run_and_join();
+    }
+
+    void cmake::report_compiler_cache()
+    {
+        const auto launcher = conf().cmake().compiler_launcher();
+        if (launcher.empty())
+            return;
+
+        auto p = process()
+                     .binary(launcher)
+                     .arg("--show-stats")
+                     .stdout_flags(process::keep_in_string)
+                     .stdout_encoding(encodings::utf8)
+                     .flags(process::allow_failure);
+
+        if (p.run_and_join() != 0) {
+            gcx().warning(context::generic, "can't get statistics from {}", launcher);
+            return;
+        }
+
+        gcx().info(context::generic, "compiler cache statistics:");
+
+        for_each_line(p.stdout_string(), [&](auto&& line) {
+            if (!trim_copy(line).empty())
+                gcx().info(context::generic, "  {}", line);
+        });
+    }
+
+    namespace {
+        // set by start_distributed() when the remote hosts are reachable
+        //
+        std::atomic<bool> g_distributed_active = false;
+
+        // returns "host:port" for each remote host in the given DISTCC_HOSTS,
+        // such as "a b:3633/8,lzo localhost"; localhost, options and ssh hosts
+        // are skipped
+        //
+        std::vector<std::string> distcc_hosts(const std::string& hosts)
+        {
+            std::vector<std::string> v;
+
+            for (auto&& h : split(hosts, " \t\r\n")) {
+                // --randomize, --localslots, +zeroconf, @host for ssh
+                if (h.starts_with("-") || h.starts_with("+") || h.starts_with("@"))
+                    continue;
+
+                // limit and options, as in "host:port/4,lzo"
+                const auto host = h.substr(0, h.find_first_of("/,"));
+
+                if (host.empty() || host == "localhost")
+                    continue;
+
+                if (host.find(':') == std::string::npos)
+                    v.push_back(host + ":3632");
+                else
+                    v.push_back(host);
+            }
+
+            return v;
+        }
+    }  // namespace
+
+    void cmake::start_distributed()
+    {
+        const auto compiler = conf().cmake().distributed_compiler();
+        if (compiler.empty())
+            return;
+
+        const auto launcher = conf().cmake().compiler_launcher();
+
+        if (!launcher.empty()) {
+            // sccache ignores CCACHE_PREFIX and has its own distributed mode,
+            // misses would never be compiled remotely
+            if (path_to_utf8(launcher.stem()) == "sccache") {
+                gcx().bail_out(context::conf,
+                               "distributed_compiler can't be used with sccache as "
+                               "compiler_launcher, use sccache's own distributed "
+                               "compilation instead");
+            }
+
+            // the compiler cache forwards misses to the distributed compiler
+            this_env::set("CCACHE_PREFIX", path_to_utf8(compiler));
+        }
+
+        const auto hosts = conf().cmake().distributed_hosts();
+        if (!hosts.empty())
+            this_env::set("DISTCC_HOSTS", hosts);
+
+        // the scheduler if there's one, or the hosts given to distcc
+        const auto scheduler = conf().cmake().distributed_scheduler();
+
+        const auto check =
+            (scheduler.empty() ? distcc_hosts(hosts) : std::vector{scheduler});
+
+        if (check.empty()) {
+            // distcc's own configuration, or only localhost; the remote hosts
+            // might not be there, so the number of jobs stays the same
+            gcx().info(context::generic,
+                       "compiling with {}, no hosts to check, not raising the "
+                       "number of jobs",
+                       compiler);
+
+            return;
+        }
+
+        const bool reachable =
+            std::any_of(check.begin(), check.end(), [](auto&& host_port) {
+                return can_connect(host_port, std::chrono::milliseconds(2000));
+            });
+
+        if (!reachable) {
+            gcx().warning(context::generic,
+                          "{} not reachable, {} will only compile locally",
+                          join(check, ", "), compiler);
+
+            // distcc only uses the given hosts, icecc doesn't contact the
+            // scheduler when ICECC is "no"; a bare "localhost" is limited to
+            // two jobs by distcc, give it one per core
+            this_env::set(
+                "DISTCC_HOSTS",
+                std::format("localhost/{}",
+                            std::max(std::thread::hardware_concurrency(), 1u)));
+            this_env::set("ICECC", "no");
+
+            return;
+        }
+
+        g_distributed_active = true;
+
+        gcx().info(context::generic, "compiling with {} using {} jobs", compiler,
+                   *distributed_jobs());
+    }
+
+    std::optional<int> cmake::distributed_jobs()
+    {
+        if (!g_distributed_active)
+            return {};
+
+        const auto jobs = conf().cmake().distributed_jobs();
+        if (jobs > 0)
+            return jobs;
+
+        // most of the work happens on the remote hosts, the local cores only
+        // preprocess and wait
+        return static_cast<int>(
+            std::max(std::thread::hardware_concurrency(), 1u) * 4);
+    }
+
     cmake& cmake::generator(generators g)
     {
         gen_ = g;
@@ -133,6 +509,17 @@ namespace mob {
         return *this;
     }
 
+    cmake& cmake::allow_failure()
+    {
+        allow_failure_ = true;
+        return *this;
+    }
+
+    const std::vector<std::string>& cmake::failed_targets() const
+    {
+        return failed_;
+    }
+
     fs::path cmake::build_path() const
     {
         // use anything given in output()
@@ -199,15 +586,18 @@ namespace mob {
             for (const auto& c : config_types_) {
                 if (!types.empty())
                     types += ";";
-                types += config_to_string(c);
+                types += config_name(c);
             }
             p = p.arg("-DCMAKE_CONFIGURATION_TYPES=" + types);
         }
 
-        p = p.arg("-DCMAKE_INSTALL_MESSAGE=" +
-                  conf_cmake::to_string(conf().cmake().install_message()))
-                .arg("--log-level=ERROR")
-                .arg("--no-warn-unused-cli");
+        for (auto&& [name, value] : common_definitions())
+            p.arg("-D" + name + "=", value, process::quote);
+
+        for (auto&& name : common_undefinitions())
+            p.arg("-U" + name);
+
+        p = p.arg("--log-level=ERROR").arg("--no-warn-unused-cli");
 
         // prefix
         if (!prefix_.empty())
@@ -237,12 +627,76 @@ namespace mob {
                 p.arg(cmd_);
         }
 
-        p.env(env::vs(arch_)
-                  .set("CXXFLAGS", "/wd4566")
-                  .set("VCPKG_ROOT", absolute(conf().path().vcpkg()).string()))
-            .cwd(preset_.empty() ? build_path() : root_);
+        const auto e =
+            env::vs(arch_)
+                .set("CXXFLAGS", "/wd4566")
+                .set("VCPKG_ROOT", absolute(conf().path().vcpkg()).string());
+
+        p.env(e).cwd(preset_.empty() ? build_path() : root_);
+
+        // cmake is slow to generate, even when the build directory is already
+        // up to date, so skip it when nothing changed since last time; the build
+        // tools still regenerate by themselves if a cmake file changes later
+        //
+        // the source tree is only hashed here if there's something to compare
+        // with, a new build directory gets its stamp once cmake succeeded
+        const auto stamp_file = build_path() / generate_stamp_file;
+        std::string stamp;
+
+        if (exists(build_path() / "CMakeCache.txt") && exists(stamp_file)) {
+            stamp = generate_stamp(p, e);
+
+            const auto old =
+                op::read_text_file(cx(), encodings::utf8, stamp_file, op::optional);
+
+            if (old == stamp) {
+                cx().info(context::generic, "cmake inputs unchanged, not generating");
+                return;
+            }
+        }
+
+        // a failed generate must not leave the old stamp behind
+        op::delete_file(cx(), stamp_file, op::optional);
 
         execute_and_join(p);
+
+        if (stamp.empty())
+            stamp = generate_stamp(p, e);
+
+        op::write_text_file(cx(), encodings::utf8, stamp_file, stamp);
+    }
+
+    std::string cmake::generate_stamp(const process& p, const env& e) const
+    {
+        std::string s = "cmd: " + p.command_line() + "\n";
+
+        for (auto&& [k, v] : e.get_map()) {
+            if (affects_generate(k))
+                s += std::format("env: {}={}\n", k, v);
+        }
+
+        const auto bp = fs::weakly_canonical(build_path());
+
+        const auto files = walk_directory(cx(), root_, [&](auto&& entry) {
+            if (!entry.is_directory())
+                return false;
+
+            // skips anything cmake generated, along with .git
+            const auto& p = entry.path();
+            return p.filename() == ".git" || fs::weakly_canonical(p) == bp ||
+                   exists(p / "CMakeCache.txt");
+        });
+
+        std::vector<fs::path> inputs;
+
+        for (auto&& f : files) {
+            if (is_cmake_input(f.path))
+                inputs.push_back(f.path);
+        }
+
+        s += "files: " + install_manifest::from_files(cx(), root_, inputs).hash();
+
+        return hash_string(s);
     }
 
     void cmake::do_build()
@@ -254,25 +708,51 @@ namespace mob {
                      .arg("--build")
                      .arg(build_path())
                      .arg("--config")
-                     .arg(config_to_string(config_));
+                     .arg(config_name(config_));
 
         for (auto& target : targets_) {
             p = p.arg("--target").arg(target);
         }
 
+        // options for --build, such as --parallel
+        p.args(args_);
+
+        failed_.clear();
+
+        p.stdout_filter([&](auto& f) {
+            const auto t = failed_target(f.line);
+            if (t.empty())
+                return;
+
+            // stdout has all the compiler output, make failures visible
+            f.lv = context::level::error;
+
+            if (std::find(failed_.begin(), failed_.end(), t) == failed_.end())
+                failed_.push_back(t);
+        });
+
+        if (allow_failure_)
+            p.flags(process::allow_failure);
+
         execute_and_join(p);
     }
 
     void cmake::do_install()
     {
-        execute_and_join(process()
-                             .stdout_encoding(encodings::utf8)
-                             .stderr_encoding(encodings::utf8)
-                             .binary(binary())
-                             .arg("--install")
-                             .arg(build_path())
-                             .arg("--config")
-                             .arg(config_to_string(config_)));
+        auto p = process()
+                     .stdout_encoding(encodings::utf8)
+                     .stderr_encoding(encodings::utf8)
+                     .binary(binary())
+                     .arg("--install")
+                     .arg(build_path())
+                     .arg("--config")
+                     .arg(config_name(config_));
+
+        // overrides CMAKE_INSTALL_PREFIX
+        if (!prefix_.empty())
+            p.arg("--prefix", prefix_);
+
+        execute_and_join(p);
     }
 
     void cmake::do_clean()
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../core/env.h"
 #include "../tools/tools.h"
 
 namespace mob {
@@ -14,6 +15,44 @@ namespace mob {
         //
         static fs::path binary();
 
+        // name of the given configuration, such as "RelWithDebInfo"
+        //
+        static std::string config_name(mob::config c);
+
+        // definitions that are given to every project when generating, from the
+        // options in [cmake], as name/value pairs
+        //
+        static std::vector<std::pair<std::string, std::string>> common_definitions();
+
+        // variables that are removed from the cache of every project when
+        // generating, given as -U; definitions stay in CMakeCache.txt, so
+        // options that were turned off in [cmake] have to be removed explicitly
+        //
+        static std::vector<std::string> common_undefinitions();
+
+        // if `compiler_launcher` is set in [cmake], points the cache tool to
+        // `compiler_cache` in [paths] and resets its statistics; called once
+        // before building
+        //
+        static void start_compiler_cache();
+
+        // if `compiler_launcher` is set in [cmake], logs the cache statistics
+        // since start_compiler_cache(); called once after building
+        //
+        static void report_compiler_cache();
+
+        // if `distributed_compiler` is set in [cmake], sets up its environment
+        // and checks that `distributed_scheduler` is reachable; if it isn't,
+        // the compiler is told to only build locally so the build still works
+        // and nothing has to be regenerated; called once before building
+        //
+        static void start_distributed();
+
+        // number of parallel jobs to give to each build when start_distributed()
+        // found the remote hosts, empty when compiling locally
+        //
+        static std::optional<int> distributed_jobs();
+
         // type of build files generated
         //
 #ifdef __unix__
@@ -99,7 +138,8 @@ namespace mob {
         cmake& output(const fs::path& p);
 
         // if not empty, the path is passed to cmake with
-        // `-DCMAKE_INSTALL_PREFIX=path`
+        // `-DCMAKE_INSTALL_PREFIX=path` when generating, or with `--prefix path`
+        // when installing
         //
         cmake& prefix(const fs::path& s);
 
@@ -128,6 +168,16 @@ namespace mob {
         //
         cmake& cmd(const std::string& s);
 
+        // when building, a failure doesn't bail out, see failed_targets() and
+        // exit_code()
+        //
+        cmake& allow_failure();
+
+        // targets that failed during the last build, parsed from the output of
+        // ninja or msbuild; can be given back to targets() to only build them
+        //
+        const std::vector<std::string>& failed_targets() const;
+
         // returns the path given in output(), if it was set
         //
         // if not, returns the build path based on the parameters (for example,
@@ -206,7 +256,7 @@ namespace mob {
         // configuration types
         std::vector<mob::config> config_types_;
 
-        // passed verbatim
+        // passed verbatim when generating or building
         std::vector<std::string> args_;
 
         // overrides build directory name
@@ -218,6 +268,12 @@ namespace mob {
         // overrides `..` on the command line
         std::string cmd_;
 
+        // set by allow_failure()
+        bool allow_failure_;
+
+        // filled by do_build()
+        std::vector<std::string> failed_;
+
         // deletes the build directory
         //
         void do_clean();
@@ -225,6 +281,14 @@ namespace mob {
         // runs cmake
         //
         void do_generate();
+
+        // returns a hash of everything that affects generating: the command
+        // line, the relevant environment variables and the content of the cmake
+        // files in the source tree; do_generate() saves it in the build directory
+        // and skips cmake when it hasn't changed
+        //
+        std::string generate_stamp(const process& p, const env& e) const;
+
         void do_build();
         void do_install();
 
@@ -58,6 +58,29 @@ namespace mob {
         // not interruptions so extraction is resumed later
         directory_deleter delete_output(cx(), where_);
 
+        if (is_tar()) {
+            // tar and tar.gz are handled natively, including the top-level
+            // directory
+            extract_tar();
+        }
+        else if (!is_zip() || !extract_zip()) {
+            // anything else goes through 7z, including zip files that use
+            // features the native extractor doesn't support
+            extract_with_7z(ifile.file());
+        }
+
+        // success or interruption, don't delete the directory
+        delete_output.cancel();
+
+        if (!interrupted()) {
+            // extraction finished and not interrupted, everything worked, so remove
+            // the interruption file
+            ifile.remove();
+        }
+    }
+
+    void extractor::extract_with_7z(const fs::path& ifile)
+    {
         // some archives have a top-level directory, others have files directly in
         // it, and it sucks to have special cases that know about individual
         // third parties, so this tries to figure out whether to move the files
@@ -80,54 +103,17 @@ namespace mob {
         // so the handling of a duplicate directory is done manually in
         // check_duplicate_directory() below, unfortunately
 
-        if (file_.u8string().ends_with(u8".tar.gz")) {
-            // tar in gz, must be piped, 7z can't do it in one step
-
-            cx().trace(context::generic, "this is a tar.gz, piping");
-
-            // untar
-            auto extract_tar = process()
-                                   .binary(binary())
-                                   .arg("x")     // extract
-                                   .arg("-so")   // output to stdout
-                                   .arg(file_);  // input file
-
-            // decompress
-            auto extract_gz = process()
-                                  .binary(binary())
-                                  .arg("x")      // extract
-                                  .arg("-aoa")   // overwrite all without prompt
-                                  .arg("-si")    // read from stdin
-                                  .arg("-ttar")  // type is tar
-                                  .arg("-o", where_, process::nospace);  // output file
-
-            auto piped = process::pipe(extract_tar, extract_gz);
-            execute_and_join(piped);
-        }
-        else {
-            // not tar, just extract directly
-
-            execute_and_join(process()
-                                 .binary(binary())
-                                 .arg("x")     // extract
-                                 .arg("-aoa")  // overwrite all without prompt
-                                 .arg("-bd")   // no progress indicator
-                                 .arg("-bb0")  // disable log
-                                 .arg("-o", where_, process::nospace)  // output file
-                                 .arg(file_));                         // input file
-        }
+        execute_and_join(process()
+                             .binary(binary())
+                             .arg("x")     // extract
+                             .arg("-aoa")  // overwrite all without prompt
+                             .arg("-bd")   // no progress indicator
+                             .arg("-bb0")  // disable log
+                             .arg("-o", where_, process::nospace)  // output file
+                             .arg(file_));                         // input file
 
         // moves files up if necessary
-        check_for_top_level_directory(ifile.file());
-
-        // success or interruption, don't delete the directory
-        delete_output.cancel();
-
-        if (!interrupted()) {
-            // extraction finished and not interrupted, everything worked, so remove
-            // the interruption file
-            ifile.remove();
-        }
+        check_for_top_level_directory(ifile);
     }
 
     void extractor::check_for_top_level_directory(const fs::path& ifile)
@@ -201,19 +187,52 @@ namespace mob {
         op::delete_directory(cx(), temp_dir);
     }
 
+    void archiver::add_compression_args(process& p, compression c,
+                                        std::size_t threads)
+    {
+        switch (c) {
+        case compression::store:
+            p.arg("-mx=0");
+            break;
+
+        case compression::fast:
+            p.arg("-m0=lzma2").arg("-mx=1");
+            break;
+
+        case compression::max:
+            p.arg("-m0=lzma2").arg("-mx=9");
+            break;
+
+        case compression::normal:
+        default:
+            p.arg("-m0=lzma2").arg("-mx=5");
+            break;
+        }
+
+        // lzma2 splits the input in blocks that are compressed on separate
+        // threads
+        if (threads > 0)
+            p.arg(std::format("-mmt={}", threads));
+        else
+            p.arg("-mmt=on");
+    }
+
     void archiver::create_from_glob(const context& cx, const fs::path& out,
                                     const fs::path& glob,
-                                    const std::vector<std::string>& ignore)
+                                    const std::vector<std::string>& ignore,
+                                    compression c, std::size_t threads)
     {
         op::create_directories(cx, out.parent_path());
 
         auto p = process()
                      .binary(extractor::binary())
-                     .arg("a")      // add to archive
-                     .arg(out)      // output file
-                     .arg("-r")     // recursive
-                     .arg("-mx=5")  // normal compression level
-                     .arg(glob);    // input file
+                     .arg("a")    // add to archive
+                     .arg(out)    // output file
+                     .arg("-r");  // recursive
+
+        add_compression_args(p, c, threads);
+
+        p.arg(glob);  // input file
 
         for (auto&& i : ignore) {
             // x: exclude
@@ -228,7 +247,8 @@ namespace mob {
 
     void archiver::create_from_files(const context& cx, const fs::path& out,
                                      const std::vector<fs::path>& files,
-                                     const fs::path& files_root)
+                                     const fs::path& files_root, compression c,
+                                     std::size_t threads)
     {
         std::string list_file_text;
         std::error_code ec;
@@ -262,9 +282,12 @@ namespace mob {
                      .binary(extractor::binary())
                      .arg("a")  // add to archive
                      .arg(out)  // output file
-                     .arg("@", list_file, process::nospace)
                      .cwd(files_root);
 
+        add_compression_args(p, c, threads);
+
+        p.arg("@", list_file, process::nospace);
+
         p.run();
         p.join();
     }
@@ -0,0 +1,1489 @@
+#include "pch.h"
+#include "../core/conf.h"
+#include "../core/context.h"
+#include "../core/op.h"
+#include "../utility/threading.h"
+#include "tools.h"
+#include <zlib.h>
+
+// native extraction of .tar, .tar.gz and .zip archives, used by extractor
+//
+// decompression of a tar.gz is inherently serial, so the main thread reads the
+// archive and hands small files to a thread pool in batches, which matters for
+// archives with thousands of tiny files; large files are streamed directly to
+// disk with big buffers
+//
+// zip files have a central directory, so entries are split across threads that
+// each open the archive and inflate their own share
+//
+// archives that have a top-level directory with the same name as the output
+// directory are flattened while extracting, see
+// extractor::check_for_top_level_directory() for the 7z equivalent
+
+namespace mob {
+
+    namespace {
+
+        // size of the buffers used to read archives and write large files
+        //
+        constexpr std::size_t io_buffer_size = 1024 * 1024;
+
+        // files up to this size are read in memory and written by the thread
+        // pool, larger ones are streamed to disk by the reading thread
+        //
+        constexpr std::uintmax_t small_file_size = 1024 * 1024;
+
+        // a batch of small files is given to the thread pool when it reaches
+        // either limit
+        //
+        constexpr std::uintmax_t batch_max_bytes = 8 * 1024 * 1024;
+        constexpr std::size_t batch_max_files    = 256;
+
+        // number of threads writing files
+        //
+        std::size_t writer_thread_count()
+        {
+            return std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1,
+                                           8);
+        }
+
+        file_ptr open_file(const fs::path& p, const char* mode)
+        {
+#ifdef _WIN32
+            return file_ptr(_wfopen(p.native().c_str(), utf8_to_utf16(mode).c_str()));
+#else
+            return file_ptr(std::fopen(p.native().c_str(), mode));
+#endif
+        }
+
+        bool seek_file(std::FILE* f, std::uint64_t offset)
+        {
+#ifdef _WIN32
+            return (_fseeki64(f, static_cast<__int64>(offset), SEEK_SET) == 0);
+#else
+            return (fseeko(f, static_cast<off_t>(offset), SEEK_SET) == 0);
+#endif
+        }
+
+        std::uint16_t le16(const unsigned char* p)
+        {
+            return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+        }
+
+        std::uint32_t le32(const unsigned char* p)
+        {
+            return static_cast<std::uint32_t>(p[0]) |
+                   (static_cast<std::uint32_t>(p[1]) << 8) |
+                   (static_cast<std::uint32_t>(p[2]) << 16) |
+                   (static_cast<std::uint32_t>(p[3]) << 24);
+        }
+
+        std::uint64_t le64(const unsigned char* p)
+        {
+            return static_cast<std::uint64_t>(le32(p)) |
+                   (static_cast<std::uint64_t>(le32(p + 4)) << 32);
+        }
+
+        // metadata applied to a file after it's been written
+        //
+        struct entry_info {
+            // path relative to the output directory
+            fs::path path;
+
+            // unix permissions, 0 if unknown
+            unsigned int mode = 0;
+
+            // modification time, if known
+            std::optional<std::time_t> mtime;
+        };
+
+        // sets the permissions and modification time of a written file; both
+        // are best effort
+        //
+        void finish_file(const fs::path& p, const entry_info& e)
+        {
+            std::error_code ec;
+
+#ifdef __unix__
+            // only the executable bits really matter, but keep what the archive
+            // says as long as the owner can still write to the file
+            if (e.mode != 0) {
+                const auto perms = static_cast<fs::perms>(e.mode & 0777) |
+                                   fs::perms::owner_read | fs::perms::owner_write;
+
+                fs::permissions(p, perms, ec);
+            }
+#endif
+
+            if (e.mtime) {
+                const auto t = std::chrono::file_clock::from_sys(
+                    std::chrono::system_clock::from_time_t(*e.mtime));
+
+                fs::last_write_time(p, t, ec);
+            }
+        }
+
+        // creates the file, reserves its size on disk and calls `f` with the
+        // FILE*, then sets its metadata
+        //
+        template <class F>
+        void write_file(const context& cx, const fs::path& root, const entry_info& e,
+                        std::uintmax_t size, F&& f)
+        {
+            const auto p = root / e.path;
+
+            cx.trace(context::fs, "writing {}", p);
+
+            {
+                file_ptr out = open_file(p, "wb");
+
+                if (!out) {
+                    const auto ec = GetLastError();
+                    cx.bail_out(context::fs, "can't create {}, {}", p,
+                                error_message(ec));
+                }
+
+                preallocate_file(out.get(), size);
+                f(out.get());
+
+                if (std::fflush(out.get()) != 0 || std::ferror(out.get())) {
+                    const auto ec = GetLastError();
+                    cx.bail_out(context::fs, "failed to write {}, {}", p,
+                                error_message(ec));
+                }
+            }
+
+            finish_file(p, e);
+        }
+
+        void write_all(const context& cx, std::FILE* out, const void* data,
+                       std::size_t n)
+        {
+            if (n == 0)
+                return;
+
+            if (std::fwrite(data, 1, n, out) != n) {
+                const auto ec = GetLastError();
+                cx.bail_out(context::fs, "write failed, {}", error_message(ec));
+            }
+        }
+
+        // creates directories in the output directory, remembering which ones
+        // were created already
+        //
+        class directory_creator {
+        public:
+            directory_creator(const context& cx, fs::path root)
+                : cx_(cx), root_(std::move(root))
+            {
+            }
+
+            void create(const fs::path& rel)
+            {
+                if (rel.empty() || created_.contains(rel))
+                    return;
+
+                std::error_code ec;
+                fs::create_directories(root_ / rel, ec);
+
+                if (ec) {
+                    cx_.bail_out(context::fs, "can't create directory {}, {}",
+                                 root_ / rel, ec.message());
+                }
+
+                // parents were created too
+                for (fs::path p = rel; !p.empty(); p = p.parent_path()) {
+                    if (!created_.insert(p).second)
+                        break;
+                }
+            }
+
+            void create_parent(const fs::path& rel) { create(rel.parent_path()); }
+
+        private:
+            const context& cx_;
+            fs::path root_;
+            std::set<fs::path> created_;
+        };
+
+        // remembers the first error that happened in a pool thread; bailing out
+        // from a thread would terminate the program, so the error is rethrown
+        // from the main thread by check()
+        //
+        class thread_errors {
+        public:
+            // runs f(), remembering any failure
+            //
+            template <class F>
+            void run(F&& f)
+            {
+                if (failed_)
+                    return;
+
+                try {
+                    f();
+                }
+                catch (bailed& e) {
+                    set(e.what());
+                }
+                catch (std::exception& e) {
+                    set(e.what());
+                }
+            }
+
+            bool failed() const { return failed_; }
+
+            // bails out if an error was recorded
+            //
+            void check() const
+            {
+                if (failed_) {
+                    std::scoped_lock lock(m_);
+                    throw bailed(error_);
+                }
+            }
+
+        private:
+            mutable std::mutex m_;
+            std::atomic<bool> failed_ = false;
+            std::string error_;
+
+            void set(std::string s)
+            {
+                std::scoped_lock lock(m_);
+
+                if (!failed_) {
+                    error_  = std::move(s);
+                    failed_ = true;
+                }
+            }
+        };
+
+        // accumulates small files in memory and writes them in batches on a
+        // thread pool
+        //
+        class batch_writer {
+        public:
+            batch_writer(const context& cx, fs::path root)
+                : cx_(cx), root_(std::move(root)), pool_(writer_thread_count())
+            {
+            }
+
+            // queues a file, the batch is handed to the pool when it's full
+            //
+            void add(entry_info e, std::string data)
+            {
+                errors_.check();
+
+                bytes_ += data.size();
+                batch_.push_back({std::move(e), std::move(data)});
+
+                if (bytes_ >= batch_max_bytes || batch_.size() >= batch_max_files)
+                    flush();
+            }
+
+            // gives the current batch to the pool, blocks if all the threads are
+            // busy
+            //
+            void flush()
+            {
+                if (batch_.empty())
+                    return;
+
+                auto b = std::make_shared<batch>(std::move(batch_));
+                batch_.clear();
+                bytes_ = 0;
+
+                pool_.add([this, b] {
+                    errors_.run([&] {
+                        for (auto&& f : *b) {
+                            write_file(cx_, root_, f.info, f.data.size(),
+                                       [&](std::FILE* out) {
+                                           write_all(cx_, out, f.data.data(),
+                                                     f.data.size());
+                                       });
+                        }
+                    });
+                });
+            }
+
+            // writes the remaining batch, waits for all threads and bails out if
+            // anything failed
+            //
+            void finish()
+            {
+                flush();
+                pool_.join();
+                errors_.check();
+            }
+
+        private:
+            struct pending_file {
+                entry_info info;
+                std::string data;
+            };
+
+            using batch = std::vector<pending_file>;
+
+            const context& cx_;
+            fs::path root_;
+            batch batch_;
+            std::uintmax_t bytes_ = 0;
+            thread_errors errors_;
+
+            // last so it's joined before the rest is destroyed
+            thread_pool pool_;
+        };
+
+        // splits an entry name into its components, ignoring empty and "."
+        // components; returns an empty vector for names that would end up
+        // outside the output directory
+        //
+        std::vector<std::string> split_entry_name(std::string_view name)
+        {
+            std::vector<std::string> parts;
+            std::string current;
+
+            auto add = [&] {
+                if (!current.empty() && current != ".")
+                    parts.push_back(std::move(current));
+
+                current.clear();
+            };
+
+            for (char c : name) {
+                if (c == '/' || c == '\\')
+                    add();
+                else
+                    current += c;
+            }
+
+            add();
+
+            for (auto&& p : parts) {
+                // parent directories or drive letters
+                if (p == ".." || p.find(':') != std::string::npos)
+                    return {};
+            }
+
+            return parts;
+        }
+
+        fs::path join_entry_parts(std::vector<std::string>::const_iterator begin,
+                                  std::vector<std::string>::const_iterator end)
+        {
+            fs::path p;
+
+            for (auto itor = begin; itor != end; ++itor)
+                p /= fs::path(std::u8string(itor->begin(), itor->end()));
+
+            return p;
+        }
+
+        // figures out whether the archive has a top-level directory with the same
+        // name as the output directory and strips it from entry names; loose
+        // files next to that directory are skipped, just like
+        // extractor::check_for_top_level_directory() deletes them, and any other
+        // top-level directory next to it is an error
+        //
+        // when streaming, the first top-level directory decides: if it's not the
+        // same-named one, entries are extracted as-is, but finding the
+        // same-named directory later still bails out, because it sits next to
+        // another directory
+        //
+        class top_level_filter {
+        public:
+            enum class actions {
+                // extract the entry to the given path
+                extract,
+
+                // ignore the entry
+                skip,
+
+                // top-level file before any directory was seen, can't know yet
+                // whether it should be extracted; see hold() and decided()
+                hold
+            };
+
+            top_level_filter(const context& cx, std::string dir_name)
+                : cx_(cx), dir_name_(std::move(dir_name))
+            {
+            }
+
+            // decides upfront when all the names are known, used for zip files
+            //
+            void decide(const std::vector<std::pair<std::string, bool>>& entries)
+            {
+                state_ = states::keep;
+
+                for (auto&& [name, is_dir] : entries) {
+                    const auto parts = split_entry_name(name);
+
+                    if (parts.size() > (is_dir ? 0 : 1) && parts[0] == dir_name_) {
+                        set_state(states::strip);
+                        return;
+                    }
+                }
+
+                set_state(states::keep);
+            }
+
+            // whether the archive has been found to have a top-level directory
+            // or not
+            //
+            bool decided() const { return (state_ != states::undecided); }
+
+            // whether entries are moved up one directory; only valid when
+            // decided() is true
+            //
+            bool stripping() const { return (state_ == states::strip); }
+
+            // returns what to do with the given entry; `rel` is set to the path
+            // relative to the output directory for `extract` and `hold`
+            //
+            actions filter(std::string_view name, bool is_dir, fs::path& rel)
+            {
+                const auto parts = split_entry_name(name);
+
+                if (parts.empty()) {
+                    if (!name.empty() && name != "." && name != "./") {
+                        cx_.warning(context::fs,
+                                    "skipping {}, it would be outside the output "
+                                    "directory",
+                                    name);
+                    }
+
+                    return actions::skip;
+                }
+
+                const bool top_level_file = (parts.size() == 1 && !is_dir);
+
+                if (state_ == states::undecided) {
+                    if (top_level_file) {
+                        rel = join_entry_parts(parts.begin(), parts.end());
+                        return actions::hold;
+                    }
+
+                    // first directory, decides whether everything else is
+                    // stripped
+                    set_state(parts[0] == dir_name_ ? states::strip : states::keep);
+                }
+
+                if (state_ == states::keep) {
+                    // a same-named directory after another one, which
+                    // check_for_top_level_directory() doesn't handle either
+                    if (parts[0] == dir_name_ && !top_level_file) {
+                        cx_.bail_out(context::generic,
+                                     "{} is next to another top-level directory",
+                                     name);
+                    }
+
+                    rel = join_entry_parts(parts.begin(), parts.end());
+                    return actions::extract;
+                }
+
+                if (parts[0] == dir_name_) {
+                    // the directory itself
+                    if (parts.size() == 1)
+                        return actions::skip;
+
+                    rel = join_entry_parts(parts.begin() + 1, parts.end());
+                    return actions::extract;
+                }
+
+                if (top_level_file) {
+                    cx_.trace(context::generic, "assuming file {} is useless, skipping",
+                              name);
+
+                    return actions::skip;
+                }
+
+                // don't know what to do with archives that have the same
+                // directory _and_ other directories, bail out for now
+                cx_.bail_out(context::generic,
+                             "{} is yet another directory next to {}", name,
+                             dir_name_);
+            }
+
+            // maps a name without side effects, used for hard link targets;
+            // returns an empty path if the entry wouldn't be extracted
+            //
+            fs::path map(std::string_view name) const
+            {
+                const auto parts = split_entry_name(name);
+
+                if (parts.empty())
+                    return {};
+
+                if (state_ == states::strip) {
+                    if (parts.size() < 2 || parts[0] != dir_name_)
+                        return {};
+
+                    return join_entry_parts(parts.begin() + 1, parts.end());
+                }
+
+                return join_entry_parts(parts.begin(), parts.end());
+            }
+
+        private:
+            enum class states { undecided, keep, strip };
+
+            const context& cx_;
+            std::string dir_name_;
+            states state_ = states::undecided;
+
+            void set_state(states s)
+            {
+                state_ = s;
+
+                if (s == states::strip) {
+                    cx_.trace(context::generic,
+                              "archive has a top-level directory {} with the "
+                              "same name as the output dir; moving everything up "
+                              "one",
+                              dir_name_);
+                }
+                else {
+                    cx_.trace(context::generic,
+                              "no top-level directory {}, leaving as-is",
+                              dir_name_);
+                }
+            }
+        };
+
+        // links are created once everything else has been extracted
+        //
+        struct deferred_link {
+            // path of the link relative to the output directory
+            fs::path path;
+
+            // for symlinks, the target as stored in the archive; for hard links,
+            // the path of the target relative to the output directory
+            fs::path target;
+
+            bool hard;
+        };
+
+        void create_links(const context& cx, const fs::path& root,
+                          const std::vector<deferred_link>& links)
+        {
+            for (auto&& l : links) {
+                const auto p = root / l.path;
+                std::error_code ec;
+
+                fs::remove(p, ec);
+
+                if (l.hard) {
+                    cx.trace(context::fs, "copying hard link {} from {}", p,
+                             root / l.target);
+
+                    fs::copy_file(root / l.target, p,
+                                  fs::copy_options::overwrite_existing, ec);
+                }
+                else {
+#ifdef __unix__
+                    cx.trace(context::fs, "creating symlink {} to {}", p, l.target);
+                    fs::create_symlink(l.target, p, ec);
+#else
+                    cx.warning(context::fs, "skipping symlink {} to {}", p,
+                               l.target);
+                    continue;
+#endif
+                }
+
+                if (ec) {
+                    cx.bail_out(context::fs, "can't create link {}, {}", p,
+                                ec.message());
+                }
+            }
+        }
+
+        // reads a gzip file, which also transparently reads uncompressed files
+        //
+        class gz_reader {
+        public:
+            gz_reader(const context& cx, const fs::path& file)
+                : cx_(cx), file_(file), gz_(nullptr)
+            {
+#ifdef _WIN32
+                gz_ = gzopen_w(file.native().c_str(), "rb");
+#else
+                gz_ = gzopen(file.native().c_str(), "rb");
+#endif
+
+                if (!gz_)
+                    cx_.bail_out(context::fs, "can't open {}", file_);
+
+                gzbuffer(gz_, static_cast<unsigned int>(io_buffer_size));
+            }
+
+            ~gz_reader()
+            {
+                if (gz_)
+                    gzclose(gz_);
+            }
+
+            gz_reader(const gz_reader&)            = delete;
+            gz_reader& operator=(const gz_reader&) = delete;
+
+            // reads exactly `n` bytes; returns false if the end of the file was
+            // reached before anything was read, bails out on truncated files
+            //
+            bool read(void* data, std::size_t n)
+            {
+                auto* p           = static_cast<char*>(data);
+                std::size_t total = 0;
+
+                while (total < n) {
+                    const auto chunk = static_cast<unsigned int>(
+                        std::min<std::size_t>(n - total, io_buffer_size));
+
+                    const int r = gzread(gz_, p + total, chunk);
+
+                    if (r < 0) {
+                        int e           = 0;
+                        const char* msg = gzerror(gz_, &e);
+                        cx_.bail_out(context::fs, "failed to read {}, {}", file_,
+                                     msg ? msg : "unknown error");
+                    }
+
+                    if (r == 0) {
+                        if (total == 0)
+                            return false;
+
+                        cx_.bail_out(context::fs, "{} is truncated", file_);
+                    }
+
+                    total += static_cast<std::size_t>(r);
+                }
+
+                return true;
+            }
+
+            // reads exactly `n` bytes into a string
+            //
+            std::string read_string(std::uintmax_t n)
+            {
+                std::string s(static_cast<std::size_t>(n), '\0');
+
+                if (n > 0 && !read(s.data(), s.size()))
+                    cx_.bail_out(context::fs, "{} is truncated", file_);
+
+                return s;
+            }
+
+            // skips `n` bytes
+            //
+            // gzseek() takes and returns a z_off_t, which is a 32-bit long on
+            // windows and fails past 2GB; seeking forward decompresses
+            // everything anyway, so this reads and discards instead
+            //
+            void skip(std::uintmax_t n)
+            {
+                if (n == 0)
+                    return;
+
+                if (skip_buffer_.empty())
+                    skip_buffer_.resize(io_buffer_size);
+
+                while (n > 0) {
+                    const auto chunk = static_cast<std::size_t>(
+                        std::min<std::uintmax_t>(n, skip_buffer_.size()));
+
+                    if (!read(skip_buffer_.data(), chunk))
+                        cx_.bail_out(context::fs, "{} is truncated", file_);
+
+                    n -= chunk;
+                }
+            }
+
+        private:
+            const context& cx_;
+            fs::path file_;
+            gzFile gz_;
+
+            // used by skip()
+            std::vector<char> skip_buffer_;
+        };
+
+        constexpr std::size_t tar_block_size = 512;
+
+        std::uintmax_t tar_padding(std::uintmax_t size)
+        {
+            return (tar_block_size - (size % tar_block_size)) % tar_block_size;
+        }
+
+        // numeric fields are octal strings, or base-256 with the high bit set for
+        // values that don't fit
+        //
+        std::uintmax_t parse_tar_number(const char* p, std::size_t n)
+        {
+            std::uintmax_t v = 0;
+
+            if (n > 0 && (static_cast<unsigned char>(p[0]) & 0x80)) {
+                v = static_cast<unsigned char>(p[0]) & 0x7f;
+
+                for (std::size_t i = 1; i < n; ++i)
+                    v = (v << 8) | static_cast<unsigned char>(p[i]);
+
+                return v;
+            }
+
+            std::size_t i = 0;
+
+            while (i < n && p[i] == ' ')
+                ++i;
+
+            for (; i < n; ++i) {
+                if (p[i] < '0' || p[i] > '7')
+                    break;
+
+                v = v * 8 + static_cast<std::uintmax_t>(p[i] - '0');
+            }
+
+            return v;
+        }
+
+        std::string tar_string(const char* p, std::size_t n)
+        {
+            return std::string(p, strnlen(p, n));
+        }
+
+        bool tar_header_valid(const std::array<char, tar_block_size>& h)
+        {
+            // checksum is the sum of all the bytes with the checksum field itself
+            // filled with spaces
+            const auto expected = parse_tar_number(h.data() + 148, 8);
+
+            std::uintmax_t sum = 0;
+            for (std::size_t i = 0; i < h.size(); ++i) {
+                if (i >= 148 && i < 156)
+                    sum += ' ';
+                else
+                    sum += static_cast<unsigned char>(h[i]);
+            }
+
+            return (sum == expected);
+        }
+
+        // pax extended headers are a series of "length key=value\n" records
+        //
+        std::map<std::string, std::string> parse_pax(std::string_view s)
+        {
+            std::map<std::string, std::string> values;
+
+            while (!s.empty()) {
+                const auto space = s.find(' ');
+                if (space == std::string_view::npos)
+                    break;
+
+                std::size_t length = 0;
+                const auto r = std::from_chars(s.data(), s.data() + space, length);
+
+                if (r.ec != std::errc() || length <= space || length > s.size())
+                    break;
+
+                auto record = s.substr(space + 1, length - space - 1);
+
+                if (record.ends_with('\n'))
+                    record.remove_suffix(1);
+
+                const auto equal = record.find('=');
+                if (equal != std::string_view::npos) {
+                    values.emplace(std::string(record.substr(0, equal)),
+                                   std::string(record.substr(equal + 1)));
+                }
+
+                s.remove_prefix(length);
+            }
+
+            return values;
+        }
+
+        // converts the dos date and time used by zip files
+        //
+        std::optional<std::time_t> dos_time(std::uint16_t date, std::uint16_t time)
+        {
+            if (date == 0)
+                return {};
+
+            std::tm t  = {};
+            t.tm_year  = ((date >> 9) & 0x7f) + 80;
+            t.tm_mon   = ((date >> 5) & 0x0f) - 1;
+            t.tm_mday  = date & 0x1f;
+            t.tm_hour  = (time >> 11) & 0x1f;
+            t.tm_min   = (time >> 5) & 0x3f;
+            t.tm_sec   = (time & 0x1f) * 2;
+            t.tm_isdst = -1;
+
+            const auto r = std::mktime(&t);
+            if (r == static_cast<std::time_t>(-1))
+                return {};
+
+            return r;
+        }
+
+        // an entry from the central directory of a zip file
+        //
+        struct zip_entry {
+            std::string name;
+            std::uint16_t flags  = 0;
+            std::uint16_t method = 0;
+            std::uint32_t crc    = 0;
+            std::uint64_t csize  = 0;
+            std::uint64_t usize  = 0;
+            std::uint64_t offset = 0;
+            unsigned int mode    = 0;
+            bool is_dir          = false;
+            bool is_symlink      = false;
+            std::optional<std::time_t> mtime;
+
+            // set once filtered
+            fs::path path;
+        };
+
+        // compression methods
+        constexpr std::uint16_t zip_stored   = 0;
+        constexpr std::uint16_t zip_deflated = 8;
+
+        // reads the central directory, bails out if the file is not a valid zip
+        //
+        std::vector<zip_entry> read_zip_directory(const context& cx,
+                                                  const fs::path& file)
+        {
+            file_ptr f = open_file(file, "rb");
+            if (!f) {
+                const auto e = GetLastError();
+                cx.bail_out(context::fs, "can't open {}, {}", file, error_message(e));
+            }
+
+            std::error_code ec;
+            const auto file_size = fs::file_size(file, ec);
+            if (ec)
+                cx.bail_out(context::fs, "can't get size of {}, {}", file,
+                            ec.message());
+
+            auto read_at = [&](std::uint64_t offset, void* data, std::size_t n) {
+                if (!seek_file(f.get(), offset) ||
+                    std::fread(data, 1, n, f.get()) != n) {
+                    cx.bail_out(context::fs, "{} is not a valid zip file", file);
+                }
+            };
+
+            // the end of central directory record is at the end of the file,
+            // followed by a comment of up to 64KB
+            constexpr std::size_t eocd_size = 22;
+            const std::size_t tail_size     = static_cast<std::size_t>(
+                std::min<std::uintmax_t>(file_size, eocd_size + 0xffff));
+
+            if (tail_size < eocd_size)
+                cx.bail_out(context::fs, "{} is not a valid zip file", file);
+
+            std::vector<unsigned char> tail(tail_size);
+            const auto tail_offset = file_size - tail_size;
+            read_at(tail_offset, tail.data(), tail.size());
+
+            std::optional<std::size_t> eocd;
+            for (std::size_t i = tail_size - eocd_size + 1; i-- > 0;) {
+                if (le32(tail.data() + i) == 0x06054b50) {
+                    eocd = i;
+                    break;
+                }
+            }
+
+            if (!eocd)
+                cx.bail_out(context::fs, "{} is not a valid zip file", file);
+
+            const unsigned char* e  = tail.data() + *eocd;
+            std::uint64_t count     = le16(e + 10);
+            std::uint64_t cd_size   = le32(e + 12);
+            std::uint64_t cd_offset = le32(e + 16);
+
+            if (count == 0xffff || cd_size == 0xffffffff ||
+                cd_offset == 0xffffffff) {
+                // zip64, the locator is right before the end of central
+                // directory record and points to the zip64 record
+                const auto locator = tail_offset + *eocd;
+                if (locator < 20)
+                    cx.bail_out(context::fs, "{} is not a valid zip file", file);
+
+                unsigned char loc[20];
+                read_at(locator - 20, loc, sizeof(loc));
+
+                if (le32(loc) != 0x07064b50)
+                    cx.bail_out(context::fs, "{} is not a valid zip file", file);
+
+                unsigned char z64[56];
+                read_at(le64(loc + 8), z64, sizeof(z64));
+
+                if (le32(z64) != 0x06064b50)
+                    cx.bail_out(context::fs, "{} is not a valid zip file", file);
+
+                count     = le64(z64 + 32);
+                cd_size   = le64(z64 + 40);
+                cd_offset = le64(z64 + 48);
+            }
+
+            if (cd_offset + cd_size > file_size)
+                cx.bail_out(context::fs, "{} is not a valid zip file", file);
+
+            std::vector<unsigned char> cd(static_cast<std::size_t>(cd_size));
+            if (!cd.empty())
+                read_at(cd_offset, cd.data(), cd.size());
+
+            std::vector<zip_entry> entries;
+            entries.reserve(static_cast<std::size_t>(count));
+
+            std::size_t pos = 0;
+            for (std::uint64_t i = 0; i < count; ++i) {
+                if (pos + 46 > cd.size() || le32(cd.data() + pos) != 0x02014b50)
+                    cx.bail_out(context::fs, "{} has a bad central directory", file);
+
+                const unsigned char* h    = cd.data() + pos;
+                const auto name_length    = le16(h + 28);
+                const auto extra_length   = le16(h + 30);
+                const auto comment_length = le16(h + 32);
+
+                if (pos + 46 + name_length + extra_length > cd.size())
+                    cx.bail_out(context::fs, "{} has a bad central directory", file);
+
+                zip_entry ze;
+                ze.flags  = le16(h + 8);
+                ze.method = le16(h + 10);
+                ze.mtime  = dos_time(le16(h + 14), le16(h + 12));
+                ze.crc    = le32(h + 16);
+                ze.csize  = le32(h + 20);
+                ze.usize  = le32(h + 24);
+                ze.offset = le32(h + 42);
+                ze.name.assign(reinterpret_cast<const char*>(h + 46), name_length);
+
+                // the upper byte of "version made by" is the host, 3 is unix,
+                // which stores the mode in the upper word of the external
+                // attributes
+                const auto host = le16(h + 4) >> 8;
+                const auto ext  = le32(h + 38);
+
+                if (host == 3) {
+                    const auto mode = ext >> 16;
+                    ze.mode         = mode & 07777;
+                    ze.is_symlink   = ((mode & 0170000) == 0120000);
+                }
+
+                ze.is_dir = ze.name.ends_with('/') || ze.name.ends_with('\\') ||
+                            (host == 0 && (ext & 0x10));
+
+                // zip64 extended information, only has the fields that are
+                // saturated in the header, in this order
+                const unsigned char* x     = h + 46 + name_length;
+                const unsigned char* x_end = x + extra_length;
+
+                while (x + 4 <= x_end) {
+                    const auto id              = le16(x);
+                    const auto size            = le16(x + 2);
+                    const unsigned char* d     = x + 4;
+                    const unsigned char* d_end = std::min(d + size, x_end);
+
+                    if (id == 0x0001) {
+                        auto next = [&](std::uint64_t& v) {
+                            if (v == 0xffffffff && d + 8 <= d_end) {
+                                v = le64(d);
+                                d += 8;
+                            }
+                        };
+
+                        next(ze.usize);
+                        next(ze.csize);
+                        next(ze.offset);
+                    }
+
+                    x = d_end;
+                }
+
+                entries.push_back(std::move(ze));
+                pos += 46 + name_length + extra_length + comment_length;
+            }
+
+            return entries;
+        }
+
+        // inflates or copies a zip entry into `sink`, verifies the crc
+        //
+        template <class Sink>
+        void read_zip_entry(const context& cx, const fs::path& file, std::FILE* in,
+                            const zip_entry& e, std::vector<unsigned char>& in_buffer,
+                            std::vector<unsigned char>& out_buffer, Sink&& sink)
+        {
+            // the local header has its own name and extra field lengths, the
+            // data is right after
+            unsigned char h[30];
+
+            if (!seek_file(in, e.offset) ||
+                std::fread(h, 1, sizeof(h), in) != sizeof(h) || le32(h) != 0x04034b50) {
+                cx.bail_out(context::fs, "{}: bad local header for {}", file, e.name);
+            }
+
+            if (!seek_file(in, e.offset + sizeof(h) + le16(h + 26) + le16(h + 28)))
+                cx.bail_out(context::fs, "{}: can't seek to {}", file, e.name);
+
+            std::uint64_t remaining = e.csize;
+            std::uint64_t written   = 0;
+            uLong crc               = crc32(0, nullptr, 0);
+
+            auto read_chunk = [&] {
+                const auto n = static_cast<std::size_t>(
+                    std::min<std::uint64_t>(remaining, in_buffer.size()));
+
+                if (std::fread(in_buffer.data(), 1, n, in) != n)
+                    cx.bail_out(context::fs, "{}: {} is truncated", file, e.name);
+
+                remaining -= n;
+                return n;
+            };
+
+            auto output = [&](const unsigned char* data, std::size_t n) {
+                crc = crc32(crc, data, static_cast<uInt>(n));
+                written += n;
+                sink(data, n);
+            };
+
+            if (e.method == zip_stored) {
+                while (remaining > 0) {
+                    const auto n = read_chunk();
+                    output(in_buffer.data(), n);
+                }
+            }
+            else {
+                z_stream zs = {};
+
+                if (inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+                    cx.bail_out(context::generic, "inflateInit2 failed");
+
+                guard g([&] {
+                    inflateEnd(&zs);
+                });
+
+                int r = Z_OK;
+
+                while (r != Z_STREAM_END) {
+                    if (zs.avail_in == 0) {
+                        if (remaining == 0) {
+                            cx.bail_out(context::fs, "{}: {} is truncated", file,
+                                        e.name);
+                        }
+
+                        zs.avail_in = static_cast<uInt>(read_chunk());
+                        zs.next_in  = in_buffer.data();
+                    }
+
+                    zs.next_out  = out_buffer.data();
+                    zs.avail_out = static_cast<uInt>(out_buffer.size());
+
+                    r = inflate(&zs, Z_NO_FLUSH);
+
+                    if (r != Z_OK && r != Z_STREAM_END) {
+                        cx.bail_out(context::fs, "{}: {} is corrupted, {}", file,
+                                    e.name, zs.msg ? zs.msg : "inflate failed");
+                    }
+
+                    output(out_buffer.data(), out_buffer.size() - zs.avail_out);
+                }
+            }
+
+            if (written != e.usize || crc != e.crc)
+                cx.bail_out(context::fs, "{}: {} is corrupted", file, e.name);
+        }
+
+    }  // namespace
+
+    bool extractor::is_tar() const
+    {
+        const auto s = path_to_utf8(file_.filename());
+        return s.ends_with(".tar") || s.ends_with(".tar.gz") || s.ends_with(".tgz");
+    }
+
+    bool extractor::is_zip() const
+    {
+        return path_to_utf8(file_.filename()).ends_with(".zip");
+    }
+
+    void extractor::extract_tar()
+    {
+        cx().trace(context::generic, "extracting tar natively");
+
+        gz_reader in(cx(), file_);
+        top_level_filter filter(cx(), path_to_utf8(where_.filename()));
+        directory_creator dirs(cx(), where_);
+        batch_writer writer(cx(), where_);
+
+        std::vector<deferred_link> links;
+
+        // top-level files seen before the filter could decide whether there's a
+        // top-level directory
+        std::vector<std::pair<entry_info, std::string>> held;
+
+        auto release_held = [&] {
+            if (held.empty() || !filter.decided())
+                return;
+
+            if (!filter.stripping()) {
+                for (auto&& [info, data] : held)
+                    writer.add(std::move(info), std::move(data));
+            }
+            else {
+                for (auto&& [info, data] : held) {
+                    cx().trace(context::generic,
+                               "assuming file {} is useless, skipping", info.path);
+                }
+            }
+
+            held.clear();
+        };
+
+        // set by gnu long name and pax headers, apply to the next entry
+        std::string long_name, long_link;
+        std::map<std::string, std::string> pax;
+
+        std::vector<char> buffer(io_buffer_size);
+        std::array<char, tar_block_size> h;
+
+        for (;;) {
+            if (interrupted())
+                return;
+
+            if (!in.read(h.data(), h.size()))
+                break;
+
+            // end of archive is marked by zeroed blocks
+            if (std::all_of(h.begin(), h.end(), [](char c) {
+                    return c == 0;
+                }))
+                break;
+
+            if (!tar_header_valid(h))
+                cx().bail_out(context::fs, "{}: bad tar header", file_);
+
+            const char type     = h[156];
+            std::uintmax_t size = parse_tar_number(h.data() + 124, 12);
+
+            switch (type) {
+                case 'L':  // gnu long name
+                {
+                    long_name = in.read_string(size).c_str();
+                    in.skip(tar_padding(size));
+                    continue;
+                }
+
+                case 'K':  // gnu long link name
+                {
+                    long_link = in.read_string(size).c_str();
+                    in.skip(tar_padding(size));
+                    continue;
+                }
+
+                case 'x':  // pax header for the next entry
+                {
+                    pax = parse_pax(in.read_string(size));
+                    in.skip(tar_padding(size));
+                    continue;
+                }
+
+                case 'g':  // pax global header, this is the pax_global_header
+                           // file 7z extracts
+                {
+                    in.skip(size + tar_padding(size));
+                    continue;
+                }
+            }
+
+            std::string name;
+            std::string link = tar_string(h.data() + 157, 100);
+
+            if (auto itor = pax.find("path"); itor != pax.end())
+                name = itor->second;
+            else if (!long_name.empty())
+                name = long_name;
+            else {
+                name = tar_string(h.data(), 100);
+
+                // ustar splits long names in prefix and name
+                const auto prefix = tar_string(h.data() + 345, 155);
+                if (tar_string(h.data() + 257, 5) == "ustar" && !prefix.empty())
+                    name = prefix + "/" + name;
+            }
+
+            if (auto itor = pax.find("linkpath"); itor != pax.end())
+                link = itor->second;
+            else if (!long_link.empty())
+                link = long_link;
+
+            if (auto itor = pax.find("size"); itor != pax.end())
+                size = std::strtoull(itor->second.c_str(), nullptr, 10);
+
+            entry_info info;
+            info.mode  = static_cast<unsigned int>(parse_tar_number(h.data() + 100, 8));
+            info.mtime = static_cast<std::time_t>(parse_tar_number(h.data() + 136, 12));
+
+            if (auto itor = pax.find("mtime"); itor != pax.end())
+                info.mtime = static_cast<std::time_t>(
+                    std::strtoll(itor->second.c_str(), nullptr, 10));
+
+            long_name.clear();
+            long_link.clear();
+            pax.clear();
+
+            const bool is_dir =
+                (type == '5' || ((type == '0' || type == 0) && name.ends_with('/')));
+
+            const bool is_file =
+                !is_dir && (type == '0' || type == 0 || type == '7');
+
+            const bool is_link = (type == '1' || type == '2');
+
+            if (!is_dir && !is_file && !is_link) {
+                // devices, fifos, etc.
+                cx().trace(context::generic, "skipping {}, unsupported type '{}'",
+                           name, type);
+
+                in.skip(size + tar_padding(size));
+                continue;
+            }
+
+            const auto action = filter.filter(name, is_dir, info.path);
+            release_held();
+
+            if (action == top_level_filter::actions::skip) {
+                in.skip(size + tar_padding(size));
+                continue;
+            }
+
+            if (is_dir) {
+                dirs.create(info.path);
+                in.skip(size + tar_padding(size));
+                continue;
+            }
+
+            if (is_link) {
+                if (action == top_level_filter::actions::hold) {
+                    // a link next to a potential top-level directory, not
+                    // worth handling
+                    cx().trace(context::generic, "skipping top-level link {}",
+                               name);
+                }
+                else if (type == '1') {
+                    const auto target = filter.map(link);
+
+                    if (target.empty()) {
+                        cx().warning(context::fs,
+                                     "skipping hard link {}, target {} is not "
+                                     "extracted",
+                                     name, link);
+                    }
+                    else {
+                        dirs.create_parent(info.path);
+                        links.push_back({info.path, target, true});
+                    }
+                }
+                else {
+                    dirs.create_parent(info.path);
+                    links.push_back(
+                        {info.path, fs::path(std::u8string(link.begin(), link.end())),
+                         false});
+                }
+
+                in.skip(size + tar_padding(size));
+                continue;
+            }
+
+            if (action == top_level_filter::actions::hold) {
+                held.emplace_back(std::move(info), in.read_string(size));
+                in.skip(tar_padding(size));
+                continue;
+            }
+
+            dirs.create_parent(info.path);
+
+            if (size <= small_file_size) {
+                writer.add(std::move(info), in.read_string(size));
+                in.skip(tar_padding(size));
+                continue;
+            }
+
+            // large file, stream it from here
+            write_file(cx(), where_, info, size, [&](std::FILE* out) {
+                std::setvbuf(out, nullptr, _IOFBF, io_buffer_size);
+
+                std::uintmax_t remaining = size;
+
+                while (remaining > 0) {
+                    const auto n = static_cast<std::size_t>(
+                        std::min<std::uintmax_t>(remaining, buffer.size()));
+
+                    if (!in.read(buffer.data(), n))
+                        cx().bail_out(context::fs, "{} is truncated", file_);
+
+                    write_all(cx(), out, buffer.data(), n);
+                    remaining -= n;
+                }
+            });
+
+            in.skip(tar_padding(size));
+        }
+
+        // only top-level files, write them
+        if (!held.empty()) {
+            for (auto&& [info, data] : held)
+                writer.add(std::move(info), std::move(data));
+        }
+
+        writer.finish();
+        create_links(cx(), where_, links);
+    }
+
+    bool extractor::extract_zip()
+    {
+        cx().trace(context::generic, "extracting zip natively");
+
+        auto entries = read_zip_directory(cx(), file_);
+
+        for (auto&& e : entries) {
+            if (e.flags & 0x1) {
+                cx().debug(context::generic, "{} is encrypted, falling back to 7z",
+                           e.name);
+                return false;
+            }
+
+            if (!e.is_dir && e.method != zip_stored && e.method != zip_deflated) {
+                cx().debug(context::generic,
+                           "{} uses compression method {}, falling back to 7z",
+                           e.name, e.method);
+                return false;
+            }
+        }
+
+        top_level_filter filter(cx(), path_to_utf8(where_.filename()));
+
+        {
+            std::vector<std::pair<std::string, bool>> names;
+            names.reserve(entries.size());
+
+            for (auto&& e : entries)
+                names.emplace_back(e.name, e.is_dir);
+
+            filter.decide(names);
+        }
+
+        // everything but the files is handled here, directories are all
+        // created upfront so the threads don't have to
+        directory_creator dirs(cx(), where_);
+        std::vector<const zip_entry*> files;
+        std::uint64_t total_size = 0;
+
+        for (auto&& e : entries) {
+            if (filter.filter(e.name, e.is_dir, e.path) ==
+                top_level_filter::actions::skip) {
+                continue;
+            }
+
+            if (e.is_dir) {
+                dirs.create(e.path);
+                continue;
+            }
+
+            dirs.create_parent(e.path);
+            files.push_back(&e);
+            total_size += e.csize;
+        }
+
+        // split the files in contiguous chunks of roughly the same compressed
+        // size, one per thread
+        const auto thread_count = writer_thread_count();
+        const auto chunk_size   = std::max<std::uint64_t>(1, total_size / thread_count);
+
+        std::vector<std::vector<const zip_entry*>> chunks(1);
+        std::uint64_t current = 0;
+
+        for (auto* e : files) {
+            if (current >= chunk_size && chunks.size() < thread_count) {
+                chunks.emplace_back();
+                current = 0;
+            }
+
+            chunks.back().push_back(e);
+            current += e->csize;
+        }
+
+        std::vector<deferred_link> links;
+        std::mutex links_mutex;
+        thread_errors errors;
+
+        {
+            thread_pool pool(thread_count);
+
+            for (auto&& chunk : chunks) {
+                pool.add([&, chunk] {
+                    errors.run([&] {
+                        file_ptr in = open_file(file_, "rb");
+                        if (!in) {
+                            const auto e = GetLastError();
+                            cx().bail_out(context::fs, "can't open {}, {}", file_,
+                                          error_message(e));
+                        }
+
+                        std::vector<unsigned char> in_buffer(io_buffer_size);
+                        std::vector<unsigned char> out_buffer(io_buffer_size);
+
+                        for (auto* e : chunk) {
+                            if (interrupted() || errors.failed())
+                                return;
+
+                            if (e->is_symlink) {
+                                std::string target;
+
+                                read_zip_entry(cx(), file_, in.get(), *e, in_buffer,
+                                               out_buffer,
+                                               [&](const unsigned char* d,
+                                                   std::size_t n) {
+                                                   target.append(
+                                                       reinterpret_cast<const char*>(d),
+                                                       n);
+                                               });
+
+                                std::scoped_lock lock(links_mutex);
+                                links.push_back(
+                                    {e->path,
+                                     fs::path(std::u8string(target.begin(),
+                                                            target.end())),
+                                     false});
+
+                                continue;
+                            }
+
+                            entry_info info{e->path, e->mode, e->mtime};
+
+                            write_file(cx(), where_, info, e->usize,
+                                       [&](std::FILE* out) {
+                                           read_zip_entry(
+                                               cx(), file_, in.get(), *e, in_buffer,
+                                               out_buffer,
+                                               [&](const unsigned char* d,
+                                                   std::size_t n) {
+                                                   write_all(cx(), out, d, n);
+                                               });
+                                       });
+                        }
+                    });
+                });
+            }
+
+            pool.join();
+        }
+
+        errors.check();
+
+        if (!interrupted())
+            create_links(cx(), where_, links);
+
+        return true;
+    }
+
+}  // namespace mob
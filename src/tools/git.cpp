@@ -1,37 +1,140 @@
 #include "pch.h"
 #include "../core/conf.h"
+#include "../core/op.h"
 #include "../core/process.h"
 #include "../utility/threading.h"
 #include "tools.h"
 
 namespace mob::details {
 
-    // calls f() with each .ts file in the root, recursive
+    // returns a github url for the given org and git file
     //
-    template <class F>
-    void for_each_ts(const fs::path& root, F&& f)
+    std::string make_url(const std::string& org, const std::string& git_file,
+                         std::optional<git_url_pattern_format_string> url_pattern)
     {
-        for (auto&& e : fs::recursive_directory_iterator(root)) {
-            if (!e.is_regular_file())
-                continue;
+        return std::format(
+            url_pattern.value_or(git_url_pattern_format_string{"git@github.com:{}/{}"}),
+            org, git_file);
+    }
+
+    // reads the first line of the given file, empty if it can't be read
+    //
+    std::string read_first_line(const fs::path& p)
+    {
+        std::ifstream in(p, std::ios::binary);
+        std::string line;
+        std::getline(in, line);
+        return trim_copy(line);
+    }
 
-            const auto p = e.path();
+    // returns the commit HEAD points to in the given repo by reading the files
+    // in .git directly, or an empty string if it can't be figured out, such as
+    // for worktrees; the caller falls back to `git rev-parse HEAD`
+    //
+    std::string read_head_commit(const fs::path& repo)
+    {
+        fs::path git_dir = repo / ".git";
 
-            if (!path_to_utf8(p.extension()).ends_with(".ts"))
-                continue;
+        // submodules and such have a .git file that points to the actual
+        // directory
+        if (fs::is_regular_file(git_dir)) {
+            const auto line = read_first_line(git_dir);
+            if (!line.starts_with("gitdir:"))
+                return {};
 
-            f(p);
+            git_dir = utf8_to_utf16(trim_copy(line.substr(7)));
+            if (git_dir.is_relative())
+                git_dir = repo / git_dir;
         }
+
+        if (fs::exists(git_dir / "commondir"))
+            return {};
+
+        const auto head = read_first_line(git_dir / "HEAD");
+
+        // detached
+        if (!head.starts_with("ref:"))
+            return (head.size() == 40 ? head : std::string());
+
+        const auto ref = trim_copy(head.substr(4));
+
+        // loose ref
+        const auto loose = read_first_line(git_dir / utf8_to_utf16(ref));
+        if (loose.size() == 40)
+            return loose;
+
+        // packed ref, lines are "hash ref"
+        std::ifstream packed(git_dir / "packed-refs", std::ios::binary);
+
+        for (std::string line; std::getline(packed, line);) {
+            trim(line);
+
+            if (line.size() > 41 && line[40] == ' ' && line.substr(41) == ref)
+                return line.substr(0, 40);
+        }
+
+        return {};
     }
 
-    // returns a github url for the given org and git file
+    // returns the contents of .gitmodules with the given submodules added or
+    // replaced, keeps everything else as-is
     //
-    std::string make_url(const std::string& org, const std::string& git_file,
-                         std::optional<git_url_pattern_format_string> url_pattern)
+    std::string update_gitmodules(const std::string& existing,
+                                  const std::vector<git_wrap::submodule_info>& subs)
     {
-        return std::format(
-            url_pattern.value_or(git_url_pattern_format_string{"git@github.com:{}/{}"}),
-            org, git_file);
+        // text before the first section, then each section by name, in order
+        std::string preamble;
+        std::vector<std::pair<std::string, std::string>> sections;
+
+        // lines are kept verbatim, including empty ones; split() and
+        // for_each_line() would both drop those
+        std::string_view rest = existing;
+
+        while (!rest.empty()) {
+            const auto nl = rest.find('\n');
+            const auto n  = (nl == std::string_view::npos ? rest.size() : nl + 1);
+
+            std::string line(rest.substr(0, n));
+            rest.remove_prefix(n);
+
+            if (!line.ends_with("\n"))
+                line += "\n";
+
+            const auto t = trim_copy(line);
+
+            if (t.starts_with("[submodule \"") && t.ends_with("\"]")) {
+                sections.push_back({t.substr(12, t.size() - 14), line});
+                continue;
+            }
+
+            if (sections.empty())
+                preamble += line;
+            else
+                sections.back().second += line;
+        }
+
+        for (auto&& sm : subs) {
+            const auto text = std::format("[submodule \"{}\"]\n"
+                                          "\tpath = {}\n"
+                                          "\turl = {}\n"
+                                          "\tbranch = {}\n",
+                                          sm.name, sm.name, sm.url, sm.branch);
+
+            auto itor = std::find_if(sections.begin(), sections.end(), [&](auto&& s) {
+                return (s.first == sm.name);
+            });
+
+            if (itor == sections.end())
+                sections.push_back({sm.name, text});
+            else
+                itor->second = text;
+        }
+
+        std::string out = preamble;
+        for (auto&& [name, text] : sections)
+            out += text;
+
+        return out;
     }
 
     // creates a basic git process, used by all the functions below
@@ -87,12 +190,14 @@ namespace mob::details {
             .cwd(root);
     }
 
-    [[nodiscard]] process revert(const fs::path& root, const fs::path& file)
+    [[nodiscard]] process revert(const fs::path& root, const std::string& files)
     {
         return make_process()
             .stderr_level(context::level::trace)
             .arg("checkout")
-            .arg(file)
+            .arg("--pathspec-from-file=-")
+            .arg("--pathspec-file-nul")
+            .stdin_string(files)
             .cwd(root);
     }
 
@@ -105,26 +210,53 @@ namespace mob::details {
             .cwd(root);
     }
 
-    [[nodiscard]] process add_submodule(const fs::path& root, const std::string& branch,
-                                        const std::string& submodule,
-                                        const mob::url& url)
+    [[nodiscard]] process ls_files(const fs::path& root)
+    {
+        return make_process()
+            .stdout_flags(process::keep_in_string)
+            .stdout_encoding(encodings::utf8)
+            .arg("ls-files")
+            .arg("-z")  // nul-separated, filenames are not quoted
+            .cwd(root);
+    }
+
+    [[nodiscard]] process rev_parse_head(const fs::path& root)
+    {
+        return make_process()
+            .stdout_flags(process::keep_in_string)
+            .arg("rev-parse")
+            .arg("HEAD")
+            .cwd(root);
+    }
+
+    [[nodiscard]] process add_gitlinks(const fs::path& root, const std::string& info)
+    {
+        // .gitmodules is added first, then the --index-info lines are read from
+        // stdin, "mode hash stage\tpath"
+        return make_process()
+            .stderr_level(context::level::trace)
+            .arg("update-index")
+            .arg("--add")
+            .arg(".gitmodules")
+            .arg("--index-info")
+            .stdin_string(info)
+            .cwd(root);
+    }
+
+    [[nodiscard]] process submodule_init(const fs::path& root)
     {
         return make_process()
             .stderr_level(context::level::trace)
-            .arg("-c", "core.autocrlf=false")
             .arg("submodule")
             .arg("--quiet")
-            .arg("add")
-            .arg("-b", branch)
-            .arg("--force")
-            .arg("--name", submodule)
-            .arg(url)
-            .arg(submodule)
+            .arg("init")
             .cwd(root);
     }
 
     [[nodiscard]] process clone(const fs::path& root, const mob::url& url,
-                                const std::string& branch, bool shallow)
+                                const std::string& branch, bool shallow,
+                                const std::string& filter, bool sparse,
+                                const fs::path& reference)
     {
         auto p = make_process()
                      .stderr_level(context::level::trace)
@@ -134,6 +266,21 @@ namespace mob::details {
         if (shallow)
             p.arg("--depth", "1");
 
+        // partial clone, such as "blob:none" to download blobs only when they're
+        // checked out
+        if (!filter.empty())
+            p.arg("--filter=" + filter);
+
+        // only checks out the files at the root, the directories are added by
+        // set_sparse_checkout() after cloning
+        if (sparse)
+            p.arg("--sparse");
+
+        // objects are copied from the local mirror instead of being downloaded,
+        // --dissociate makes the clone independent from the mirror once done
+        if (!reference.empty())
+            p.arg("--reference", reference).arg("--dissociate");
+
         p.arg("--branch", branch)
             .arg("--quiet", process::log_quiet)
             .arg("-c", "advice.detachedHead=false", process::log_quiet)
@@ -143,6 +290,63 @@ namespace mob::details {
         return p;
     }
 
+    [[nodiscard]] process clone_mirror(const fs::path& root, const mob::url& url)
+    {
+        return make_process()
+            .stderr_level(context::level::trace)
+            .arg("clone")
+            .arg("--mirror")
+            .arg("--quiet", process::log_quiet)
+            .arg(url)
+            .arg(root);
+    }
+
+    [[nodiscard]] process sparse_checkout_set(const fs::path& root,
+                                              const std::vector<std::string>& dirs)
+    {
+        auto p = make_process()
+                     .stderr_level(context::level::trace)
+                     .arg("sparse-checkout")
+                     .arg("set");
+
+        for (auto&& d : dirs)
+            p.arg(d);
+
+        return p.cwd(root);
+    }
+
+    [[nodiscard]] process fetch_all(const fs::path& root)
+    {
+        return make_process()
+            .flags(process::allow_failure)
+            .stderr_level(context::level::trace)
+            .arg("fetch")
+            .arg("--all")
+            .arg("--prune")
+            .arg("--quiet", process::log_quiet)
+            .cwd(root);
+    }
+
+    [[nodiscard]] process remote_refs(const fs::path& root)
+    {
+        return make_process()
+            .stdout_flags(process::keep_in_string)
+            .arg("for-each-ref")
+            .arg("--format=%(objectname) %(refname)")
+            .arg("refs/remotes")
+            .cwd(root);
+    }
+
+    [[nodiscard]] process fetch_mirror(const fs::path& root)
+    {
+        return make_process()
+            .stderr_level(context::level::trace)
+            .arg("fetch")
+            .arg("--prune")
+            .arg("--quiet", process::log_quiet)
+            .cwd(root);
+    }
+
     [[nodiscard]] process pull(const fs::path& root, const mob::url& url,
                                const std::string& branch)
     {
@@ -191,25 +395,29 @@ namespace mob::details {
             .cwd(root);
     }
 
-    [[nodiscard]] process set_assume_unchanged(const fs::path& root,
-                                               const fs::path& file, bool on)
+    [[nodiscard]] process ls_ts_files(const fs::path& root)
     {
+        // the pathspec is quoted so it's not expanded by the shell, git matches
+        // it in all directories
         return make_process()
-            .arg("update-index")
-            .arg(on ? "--assume-unchanged" : "--no-assume-unchanged")
-            .arg(file, process::forward_slashes)
+            .stdout_flags(process::keep_in_string)
+            .stdout_encoding(encodings::utf8)
+            .arg("ls-files")
+            .arg("-z")
+            .arg("--")
+            .arg("*.ts", process::quote)
             .cwd(root);
     }
 
-    [[nodiscard]] process is_tracked(const fs::path& root, const fs::path& file)
+    [[nodiscard]] process set_assume_unchanged(const fs::path& root,
+                                               const std::string& files, bool on)
     {
         return make_process()
-            .stdout_level(context::level::debug)
-            .stderr_level(context::level::debug)
-            .flags(process::allow_failure)
-            .arg("ls-files")
-            .arg("--error-unmatch")
-            .arg(file, process::forward_slashes)
+            .arg("update-index")
+            .arg(on ? "--assume-unchanged" : "--no-assume-unchanged")
+            .arg("-z")
+            .arg("--stdin")
+            .stdin_string(files)
             .cwd(root);
     }
 
@@ -226,16 +434,14 @@ namespace mob::details {
             .cwd(root);
     }
 
-    [[nodiscard]] process remote_branch_exists(const mob::url& url,
-                                               const std::string& branch)
+    [[nodiscard]] process ls_remote_heads(const mob::url& url)
     {
         return make_process()
             .flags(process::allow_failure)
+            .stdout_flags(process::keep_in_string)
             .arg("ls-remote")
-            .arg("--exit-code")
             .arg("--heads")
-            .arg(url)
-            .arg(branch);
+            .arg(url);
     }
 
     [[nodiscard]] process has_uncommitted_changes(const fs::path& root)
@@ -249,6 +455,20 @@ namespace mob::details {
             .cwd(root);
     }
 
+    [[nodiscard]] process has_source_changes(const fs::path& root)
+    {
+        return make_process()
+            .flags(process::allow_failure)
+            .stdout_flags(process::keep_in_string)
+            .arg("status")
+            .arg("--porcelain")
+            .arg("--untracked-files=no")
+            .arg("--")
+            .arg(".")
+            .arg(":(exclude)*.ts", process::quote)
+            .cwd(root);
+    }
+
     [[nodiscard]] process has_stashed_changes(const fs::path& root)
     {
         return make_process()
@@ -306,9 +526,52 @@ namespace mob {
             return gcx();
     }
 
-    void git_wrap::clone(const mob::url& url, const std::string& branch, bool shallow)
+    void git_wrap::clone(const mob::url& url, const std::string& branch, bool shallow,
+                         const std::string& filter, bool sparse,
+                         const fs::path& reference)
     {
-        run(details::clone(root_, url, branch, shallow));
+        run(details::clone(root_, url, branch, shallow, filter, sparse, reference));
+    }
+
+    void git_wrap::set_sparse_checkout(const std::vector<std::string>& dirs)
+    {
+        run(details::sparse_checkout_set(root_, dirs));
+    }
+
+    void git_wrap::clone_mirror(const mob::url& url)
+    {
+        run(details::clone_mirror(root_, url));
+    }
+
+    void git_wrap::fetch_mirror()
+    {
+        run(details::fetch_mirror(root_));
+    }
+
+    fs::path git_wrap::mirror_path(const mob::url& u)
+    {
+        // uses the last two components of the url, which is the org and repo
+        // name for github, such as "ModOrganizer2/modorganizer.git"; the url can
+        // be either https://host/org/repo.git or git@host:org/repo.git
+        const std::string& s = u.string();
+
+        const auto last = s.find_last_of("/:");
+        std::string repo = (last == std::string::npos ? s : s.substr(last + 1));
+        if (!repo.ends_with(".git"))
+            repo += ".git";
+
+        fs::path p = conf().path().cache() / "git";
+
+        if (last != std::string::npos && last > 0) {
+            const auto sep   = s.find_last_of("/:", last - 1);
+            const auto begin = (sep == std::string::npos ? 0 : sep + 1);
+            const auto org   = s.substr(begin, last - begin);
+
+            if (!org.empty())
+                p /= org;
+        }
+
+        return p / repo;
     }
 
     void git_wrap::pull(const mob::url& url, const std::string& branch)
@@ -362,50 +625,49 @@ namespace mob {
         run(details::set_remote_push(root_, remote, url));
     }
 
-    void git_wrap::set_assume_unchanged(const fs::path& file, bool on)
+    std::string git_wrap::tracked_ts_files()
     {
-        run(details::set_assume_unchanged(root_, file, on));
+        auto p = details::ls_ts_files(root_);
+        run(p);
+        return p.stdout_string();
     }
 
     void git_wrap::ignore_ts(bool b)
     {
-        details::for_each_ts(root_, [&](auto&& p) {
-            const auto rp = fs::relative(p, root_);
+        const auto files = tracked_ts_files();
 
-            if (is_tracked(rp)) {
-                cx().trace(context::generic, "  . {}", rp);
-                set_assume_unchanged(rp, b);
-            }
-            else {
-                cx().trace(context::generic, "  . {} (skipping, not tracked)", rp);
-            }
-        });
+        if (files.empty()) {
+            cx().trace(context::generic, "no tracked .ts files");
+            return;
+        }
+
+        cx().trace(context::generic, "{} assume-unchanged on {} .ts files",
+                   (b ? "setting" : "removing"),
+                   std::count(files.begin(), files.end(), '\0'));
+
+        run(details::set_assume_unchanged(root_, files, b));
     }
 
     void git_wrap::revert_ts()
     {
-        details::for_each_ts(root_, [&](auto&& p) {
-            const auto rp = fs::relative(p, root_);
+        const auto files = tracked_ts_files();
 
-            if (is_tracked(rp)) {
-                run(details::revert(root_, p));
-            }
-            else {
-                cx().debug(context::generic,
-                           "won't try to revert ts file '{}', not tracked", rp);
+        if (files.empty()) {
+            cx().trace(context::generic, "no tracked .ts files to revert");
+            return;
+        }
 
-                return;
-            }
-        });
-    }
+        cx().trace(context::generic, "reverting {} .ts files",
+                   std::count(files.begin(), files.end(), '\0'));
 
-    bool git_wrap::is_tracked(const fs::path& file)
-    {
-        return (run(details::is_tracked(root_, file)) == 0);
+        run(details::revert(root_, files));
     }
 
     bool git_wrap::has_remote(const std::string& name)
     {
+        if (auto r = details::libgit2::has_remote(root_, name))
+            return *r;
+
         return (run(details::has_remote(root_, name)) == 0);
     }
 
@@ -444,6 +706,29 @@ namespace mob {
         run(details::fetch(root_, remote, branch));
     }
 
+    int git_wrap::fetch_all()
+    {
+        return run(details::fetch_all(root_));
+    }
+
+    std::map<std::string, std::string> git_wrap::remote_refs()
+    {
+        auto p = details::remote_refs(root_);
+        run(p);
+
+        std::map<std::string, std::string> refs;
+
+        for (auto&& line : split(p.stdout_string(), "\r\n")) {
+            const auto sp = line.find(' ');
+            if (sp == std::string::npos)
+                continue;
+
+            refs[line.substr(sp + 1)] = line.substr(0, sp);
+        }
+
+        return refs;
+    }
+
     void git_wrap::checkout(const std::string& what)
     {
         run(details::checkout(root_, what));
@@ -451,15 +736,84 @@ namespace mob {
 
     std::string git_wrap::current_branch()
     {
+        if (auto r = details::libgit2::current_branch(root_))
+            return *r;
+
         auto p = details::current_branch(root_);
         run(p);
         return trim_copy(p.stdout_string());
     }
 
-    void git_wrap::add_submodule(const std::string& branch,
-                                 const std::string& submodule, const mob::url& url)
+    std::string git_wrap::head_commit()
     {
-        run(details::add_submodule(root_, branch, submodule, url));
+        auto hash = details::read_head_commit(root_);
+        if (!hash.empty())
+            return hash;
+
+        auto p = details::rev_parse_head(root_);
+        run(p);
+        return trim_copy(p.stdout_string());
+    }
+
+    void git_wrap::add_submodules(const std::vector<submodule_info>& subs)
+    {
+        std::vector<submodule_info> added;
+        std::string info;
+
+        for (auto&& sm : subs) {
+            const auto dir = root_ / sm.name;
+
+            if (!fs::exists(dir)) {
+                cx().warning(context::generic, "can't add submodule {}, {} not found",
+                             sm.name, dir);
+                continue;
+            }
+
+            const auto hash = git_wrap(dir, runner_).head_commit();
+
+            cx().trace(context::generic, "submodule {} at {}", sm.name, hash);
+
+            info += std::format("160000 {} 0\t{}\n", hash, sm.name);
+            added.push_back(sm);
+        }
+
+        if (added.empty())
+            return;
+
+        const auto gitmodules = root_ / ".gitmodules";
+
+        std::string existing;
+        if (fs::exists(gitmodules))
+            existing = op::read_text_file(cx(), encodings::dont_know, gitmodules);
+
+        op::write_text_file(cx(), encodings::dont_know, gitmodules,
+                            details::update_gitmodules(existing, added));
+
+        run(details::add_gitlinks(root_, info));
+        run(details::submodule_init(root_));
+    }
+
+    std::vector<fs::path> git_wrap::tracked_files()
+    {
+        auto p = details::ls_files(root_);
+        run(p);
+
+        const std::string out = p.stdout_string();
+        std::vector<fs::path> files;
+
+        std::size_t start = 0;
+        while (start < out.size()) {
+            auto end = out.find('\0', start);
+            if (end == std::string::npos)
+                end = out.size();
+
+            if (end > start)
+                files.emplace_back(utf8_to_utf16(out.substr(start, end - start)));
+
+            start = end + 1;
+        }
+
+        return files;
     }
 
     std::string git_wrap::git_file()
@@ -530,30 +884,155 @@ namespace mob {
 
     bool git_wrap::is_git_repo()
     {
+        if (auto r = details::libgit2::is_git_repo(root_))
+            return *r;
+
         return (run(details::is_repo(root_)) == 0);
     }
 
     bool git_wrap::remote_branch_exists(const mob::url& u, const std::string& name)
     {
-        return (details::remote_branch_exists(u, name).run_and_join() == 0);
+        return git_remote_refs::instance().branch_exists(u, name);
     }
 
     bool git_wrap::has_uncommitted_changes()
     {
+        if (auto r = details::libgit2::has_uncommitted_changes(root_))
+            return *r;
+
         auto p = details::has_uncommitted_changes(root_);
         run(p);
         return (p.stdout_string() != "");
     }
 
+    bool git_wrap::has_source_changes()
+    {
+        if (auto r = details::libgit2::has_source_changes(root_))
+            return *r;
+
+        auto p = details::has_source_changes(root_);
+        run(p);
+        return (p.stdout_string() != "");
+    }
+
     bool git_wrap::has_stashed_changes()
     {
+        if (auto r = details::libgit2::has_stashed_changes(root_))
+            return *r;
+
         auto p = details::has_stashed_changes(root_);
         return (run(p) == 0);
     }
 
+    git_remote_refs& git_remote_refs::instance()
+    {
+        static git_remote_refs r;
+        return r;
+    }
+
+    bool git_remote_refs::branch_exists(const mob::url& u, const std::string& branch)
+    {
+        // ls-remote doesn't run, its output would be empty
+        if (conf().global().dry())
+            return true;
+
+        return get(u).contains(branch);
+    }
+
+    void git_remote_refs::prefetch(const std::vector<mob::url>& urls)
+    {
+        if (conf().global().dry())
+            return;
+
+        thread_pool tp;
+
+        for (auto&& u : urls) {
+            tp.add([this, u] {
+                try {
+                    get(u);
+                }
+                catch (bailed&) {
+                    // not cached, branch_exists() tries again and bails out
+                }
+            });
+        }
+
+        tp.join();
+    }
+
+    const git_remote_refs::branches& git_remote_refs::get(const mob::url& u)
+    {
+        std::shared_future<branches> future;
+        std::optional<std::promise<branches>> promise;
+
+        {
+            std::scoped_lock lock(mutex_);
+
+            auto itor = refs_.find(u.string());
+
+            if (itor != refs_.end()) {
+                // already cached, or being listed by another thread
+                future = itor->second;
+            }
+            else {
+                // this thread lists the branches, others will wait on the future
+                promise.emplace();
+                future = promise->get_future().share();
+                refs_.emplace(u.string(), future);
+            }
+        }
+
+        if (promise) {
+            try {
+                promise->set_value(list_branches(u));
+            }
+            catch (...) {
+                // threads already waiting get the error, later calls try again
+                promise->set_exception(std::current_exception());
+
+                std::scoped_lock lock(mutex_);
+                refs_.erase(u.string());
+            }
+        }
+
+        // the shared state is kept alive by the future in refs_
+        return future.get();
+    }
+
+    git_remote_refs::branches git_remote_refs::list_branches(const mob::url& u)
+    {
+        auto p = details::ls_remote_heads(u);
+
+        if (p.run_and_join() != 0) {
+            gcx().bail_out(context::generic, "can't list remote branches for {}",
+                           u.string());
+        }
+
+        branches bs;
+
+        // each line is "hash\trefs/heads/name"
+        for_each_line(p.stdout_string(), [&](std::string_view line) {
+            constexpr std::string_view prefix = "refs/heads/";
+
+            const auto tab = line.find('\t');
+            if (tab == std::string_view::npos)
+                return;
+
+            const auto ref = line.substr(tab + 1);
+            if (ref.starts_with(prefix))
+                bs.insert(trim_copy(ref.substr(prefix.size())));
+        });
+
+        gcx().trace(context::generic, "{} has {} remote branches", u.string(),
+                    bs.size());
+
+        return bs;
+    }
+
     git::git(ops o)
         : basic_process_runner("git"), op_(o), ignore_ts_(false), revert_ts_(false),
-          shallow_(false), no_push_upstream_(false), push_default_origin_(false)
+          shallow_(false), mirror_(false), no_push_upstream_(false),
+          push_default_origin_(false)
     {
     }
 
@@ -600,6 +1079,24 @@ namespace mob {
         return *this;
     }
 
+    git& git::mirror(bool b)
+    {
+        mirror_ = b;
+        return *this;
+    }
+
+    git& git::filter(const std::string& spec)
+    {
+        filter_ = spec;
+        return *this;
+    }
+
+    git& git::sparse(std::vector<std::string> dirs)
+    {
+        sparse_ = std::move(dirs);
+        return *this;
+    }
+
     git& git::remote(std::string org, std::string key, bool no_push_upstream,
                      bool push_default_origin)
     {
@@ -650,7 +1147,19 @@ namespace mob {
 
         git_wrap g(root_, this);
 
-        g.clone(url_, branch_, shallow_);
+        const bool sparse = !sparse_.empty();
+
+        if (mirror_) {
+            // the mirror already has the full history and all the blobs, so
+            // shallow and partial clones don't save anything
+            g.clone(url_, branch_, false, {}, sparse, update_mirror());
+        }
+        else {
+            g.clone(url_, branch_, shallow_, filter_, sparse);
+        }
+
+        if (sparse)
+            g.set_sparse_checkout(sparse_);
 
         if (!creds_username_.empty() || !creds_email_.empty())
             g.set_credentials(creds_username_, creds_email_);
@@ -666,6 +1175,54 @@ namespace mob {
         return true;
     }
 
+    fs::path git::update_mirror()
+    {
+        // tasks normally have their own repo, but this makes sure two tasks
+        // using the same url don't clone or fetch the same mirror concurrently,
+        // and that a mirror is only fetched once per run
+        static std::mutex map_mutex;
+        static std::map<fs::path, std::mutex> mutexes;
+        static std::set<fs::path> updated;
+
+        const fs::path dir = git_wrap::mirror_path(url_);
+
+        std::mutex* m = nullptr;
+
+        {
+            std::scoped_lock lock(map_mutex);
+            m = &mutexes[dir];
+        }
+
+        std::scoped_lock lock(*m);
+
+        {
+            std::scoped_lock map_lock(map_mutex);
+            if (updated.contains(dir)) {
+                cx().trace(context::generic, "mirror {} already updated", dir);
+                return dir;
+            }
+        }
+
+        git_wrap g(dir, this);
+
+        if (fs::exists(dir / "HEAD")) {
+            cx().debug(context::generic, "updating mirror {}", dir);
+            g.fetch_mirror();
+        }
+        else {
+            cx().debug(context::generic, "creating mirror {}", dir);
+            op::create_directories(cx(), dir.parent_path());
+            g.clone_mirror(url_);
+        }
+
+        {
+            std::scoped_lock map_lock(map_mutex);
+            updated.insert(dir);
+        }
+
+        return dir;
+    }
+
     void git::do_pull()
     {
         git_wrap g(root_, this);
@@ -676,8 +1233,6 @@ namespace mob {
         g.pull(url_, branch_);
     }
 
-    git_submodule::git_submodule() : basic_process_runner("git submodule") {}
-
     git_submodule& git_submodule::url(const mob::url& u)
     {
         url_ = u;
@@ -707,25 +1262,33 @@ namespace mob {
         return submodule_;
     }
 
-    void git_submodule::do_run()
+    const mob::url& git_submodule::url() const
     {
-        git_wrap(root_, this).add_submodule(branch_, submodule_, url_);
+        return url_;
     }
 
-    static std::unique_ptr<git_submodule_adder> g_sa_instance;
-    static std::mutex g_sa_instance_mutex;
+    const fs::path& git_submodule::root() const
+    {
+        return root_;
+    }
 
-    git_submodule_adder::git_submodule_adder() : cx_("submodule_adder"), quit_(false)
+    const std::string& git_submodule::branch() const
     {
-        run();
+        return branch_;
     }
 
+    static std::unique_ptr<git_submodule_adder> g_sa_instance;
+    static std::mutex g_sa_instance_mutex;
+
+    git_submodule_adder::git_submodule_adder() : cx_("submodule_adder") {}
+
     git_submodule_adder::~git_submodule_adder()
     {
-        stop();
-
-        if (thread_.joinable())
-            thread_.join();
+        // this runs at exit, possibly after a failed or interrupted build when
+        // logging is already torn down, so never run git from here; whatever is
+        // still queued is dropped, see task_manager::run_all()
+        std::scoped_lock lock(queue_mutex_);
+        queue_.clear();
     }
 
     git_submodule_adder& git_submodule_adder::instance()
@@ -741,57 +1304,9 @@ namespace mob {
     {
         std::scoped_lock lock(queue_mutex_);
         queue_.emplace_back(std::move(g));
-        wakeup();
-    }
-
-    void git_submodule_adder::run()
-    {
-        thread_ = start_thread([&] {
-            thread_fun();
-        });
     }
 
     void git_submodule_adder::stop()
-    {
-        quit_ = true;
-        wakeup();
-    }
-
-    void git_submodule_adder::thread_fun()
-    {
-        try {
-            while (!quit_) {
-                {
-                    std::unique_lock lk(sleeper_.m);
-                    sleeper_.cv.wait(lk, [&] {
-                        return sleeper_.ready;
-                    });
-                    sleeper_.ready = false;
-                }
-
-                if (quit_)
-                    break;
-
-                process();
-            }
-        }
-        catch (bailed&) {
-            // silent
-            return;
-        }
-    }
-
-    void git_submodule_adder::wakeup()
-    {
-        {
-            std::scoped_lock lk(sleeper_.m);
-            sleeper_.ready = true;
-        }
-
-        sleeper_.cv.notify_one();
-    }
-
-    void git_submodule_adder::process()
     {
         std::vector<git_submodule> v;
 
@@ -800,17 +1315,23 @@ namespace mob {
             v.swap(queue_);
         }
 
-        cx_.trace(context::generic, "git_submodule_adder: woke up, {} to process",
-                  v.size());
+        if (v.empty())
+            return;
+
+        cx_.trace(context::generic, "git_submodule_adder: {} to add", v.size());
+
+        // everything is added in one go once all the repos are cloned, grouped by
+        // super repo
+        std::map<fs::path, std::vector<git_wrap::submodule_info>> batches;
 
-        for (auto&& g : v) {
-            cx_.trace(context::generic, "git_submodule_adder: running {}",
-                      g.submodule());
+        for (auto&& g : v)
+            batches[g.root()].push_back({g.submodule(), g.url(), g.branch()});
 
-            g.run(cx_);
+        for (auto&& [root, subs] : batches) {
+            cx_.trace(context::generic, "git_submodule_adder: adding {} to {}",
+                      subs.size(), root);
 
-            if (quit_)
-                break;
+            git_wrap(root).add_submodules(subs);
         }
     }
 
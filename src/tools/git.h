@@ -1,6 +1,7 @@
 #pragma once
 
 #include <condition_variable>
+#include <future>
 
 namespace mob {
 
@@ -9,11 +10,39 @@ namespace mob {
             std::format_string<std::string const&, std::string const&>;
     }
 
+    // in-process versions of some read-only queries used by git_wrap, see
+    // git_libgit2.cpp
+    //
+    // these are only implemented when mob is built with -DMOB_LIBGIT2=ON; they
+    // return an empty optional otherwise, or when libgit2 fails or doesn't
+    // handle the case the same way git does, in which case git_wrap falls back
+    // to running the git binary
+    //
+    namespace details::libgit2 {
+        std::optional<bool> is_git_repo(const fs::path& root);
+        std::optional<std::string> current_branch(const fs::path& root);
+        std::optional<bool> has_uncommitted_changes(const fs::path& root);
+        std::optional<bool> has_source_changes(const fs::path& root);
+        std::optional<bool> has_stashed_changes(const fs::path& root);
+        std::optional<bool> has_remote(const fs::path& root, const std::string& name);
+    }  // namespace details::libgit2
+
     // wrapper around git commands used by the git tool below or various `mob git`
     // commands
     //
     class git_wrap {
     public:
+        // a submodule given to add_submodules()
+        //
+        struct submodule_info {
+            // name of the submodule, also its directory in the root
+            std::string name;
+
+            // remote url and branch, saved in .gitmodules
+            mob::url url;
+            std::string branch;
+        };
+
         // path to the git binary
         //
         static fs::path binary();
@@ -29,7 +58,35 @@ namespace mob {
         // runs `git clone` with the url and branch, adds `--depth 1` when `shallow`
         // is true
         //
-        void clone(const mob::url& url, const std::string& branch, bool shallow);
+        // filter:    if not empty, partial clone filter given to `--filter`, such
+        //            as "blob:none"
+        //
+        // sparse:    adds `--sparse`, only the files at the root are checked out
+        //            until set_sparse_checkout() is called
+        //
+        // reference: if not empty, a local mirror of the same repo used with
+        //            `--reference` and `--dissociate`
+        //
+        void clone(const mob::url& url, const std::string& branch, bool shallow,
+                   const std::string& filter = {}, bool sparse = false,
+                   const fs::path& reference = {});
+
+        // runs `git sparse-checkout set` with the given directories
+        //
+        void set_sparse_checkout(const std::vector<std::string>& dirs);
+
+        // runs `git clone --mirror` with the url, the root is the mirror directory
+        //
+        void clone_mirror(const mob::url& url);
+
+        // runs `git fetch --prune` in a mirror created by clone_mirror()
+        //
+        void fetch_mirror();
+
+        // returns the directory of the local mirror for the given url, in the
+        // cache directory, such as "cache/git/ModOrganizer2/modorganizer.git"
+        //
+        static fs::path mirror_path(const mob::url& u);
 
         // runs `git pull` with the given url and branch
         //
@@ -57,8 +114,9 @@ namespace mob {
                                              bool no_push_upstream,
                                              bool push_default_origin);
 
-        // finds all the .ts files in the root (recursive) and either sets or
-        // removes the --assume-unchanged flag on all of them
+        // finds all the .ts files tracked by git in the root and either sets or
+        // removes the --assume-unchanged flag on all of them with a single
+        // `git update-index`
         //
         // .ts files are translation files that are automatically generated by Qt
         // when building the various projects and they can change at any time;
@@ -70,18 +128,14 @@ namespace mob {
         //
         void ignore_ts(bool b);
 
-        // finds all the .ts files in the root (recursive) and reverts them (does
-        // a `git checkout` on all of them)
+        // finds all the .ts files tracked by git in the root and reverts them
+        // with a single `git checkout`
         //
         // this is used when pulling changes to revert all the .ts before pulling
         // so there are no conflicts
         //
         void revert_ts();
 
-        // returns whether the given file is known to git
-        //
-        bool is_tracked(const fs::path& file);
-
         // returns whether the given remote name exists
         //
         bool has_remote(const std::string& name);
@@ -127,9 +181,10 @@ namespace mob {
         //
         void set_config(const std::string& key, const std::string& value);
 
-        // sets --assume-unchanged or --no-assume-unchanged for the given file
+        // returns the .ts files tracked by git in the root from `git ls-files`,
+        // nul-separated, so they can be given to commands that use --stdin
         //
-        void set_assume_unchanged(const fs::path& relative_file, bool on);
+        std::string tracked_ts_files();
 
         // returns the .git file used by the origin remote, such as modorganizer.git
         //
@@ -148,14 +203,43 @@ namespace mob {
         //
         void fetch(const std::string& remote, const std::string& branch);
 
+        // runs `git fetch --all --prune`, returns the exit code instead of
+        // bailing out on failure
+        //
+        int fetch_all();
+
+        // returns all the remote-tracking refs and the hash they point to, from
+        // `git for-each-ref refs/remotes`
+        //
+        std::map<std::string, std::string> remote_refs();
+
         // runs `git checkout what`
         //
         void checkout(const std::string& what);
 
-        // runs `git submodule add` for the given branch submodule and url
+        // registers all the given repos as submodules at once, they must already
+        // be cloned in the root; this is what `git submodule add --force` does for
+        // an existing repo, but batched:
+        //
+        //  1) .gitmodules is updated directly,
+        //  2) the gitlinks for all the repos and .gitmodules are added to the
+        //     index with a single `git update-index --index-info`,
+        //  3) `git submodule init` sets the urls in .git/config
+        //
+        // the commit for each repo is read from its .git directory if possible
+        //
+        void add_submodules(const std::vector<submodule_info>& subs);
+
+        // returns the paths of all the files tracked by git, relative to the root,
+        // from `git ls-files`; this includes files that were deleted in the
+        // working tree but not committed yet
+        //
+        std::vector<fs::path> tracked_files();
+
+        // returns the commit HEAD points to, read from the .git directory if
+        // possible, or from `git rev-parse HEAD`
         //
-        void add_submodule(const std::string& branch, const std::string& submodule,
-                           const mob::url& url);
+        std::string head_commit();
 
         // returns the output of `git branch --show-current`, which is the name of
         // the active branch
@@ -171,6 +255,11 @@ namespace mob {
         //
         bool has_uncommitted_changes();
 
+        // same as has_uncommitted_changes(), but ignores untracked files and .ts
+        // files, which are regenerated by every build
+        //
+        bool has_source_changes();
+
         // whether the repo has stashed changes (checks `git stash show`); see
         // delete_directory() below
         //
@@ -185,12 +274,13 @@ namespace mob {
         //
         static void delete_directory(const context& cx, const fs::path& dir);
 
-        // runs `git ls-remote` to check if the repo at the url has the given branch
-        // name
+        // checks if the repo at the url has the given branch name, uses
+        // git_remote_refs so `git ls-remote` only runs once per url
         //
         // used mostly by `mob release official` when given a branch name to make
         // sure the branch exists in all repos before starting the build so it
-        // doesn't fail in the middle
+        // doesn't fail in the middle, and by the modorganizer tasks for
+        // mo_fallback
         //
         static bool remote_branch_exists(const mob::url& u, const std::string& name);
 
@@ -215,6 +305,54 @@ namespace mob {
         const context& cx();
     };
 
+    // cache of the branches available in remote repos, kept for the duration of
+    // the run
+    //
+    // `git ls-remote --heads` is run once per url and lists all the branches, so
+    // checking for several branches in the same repo, or checking the same repo
+    // from different tasks and commands, doesn't go back to the network
+    //
+    class git_remote_refs {
+    public:
+        // only one instance
+        //
+        static git_remote_refs& instance();
+
+        // whether the repo at the given url has a branch with the given name,
+        // lists the remote branches first if they're not cached
+        //
+        // bails out if the repo can't be reached, failures are not cached so the
+        // next call tries again; always true with --dry since ls-remote doesn't
+        // run
+        //
+        bool branch_exists(const mob::url& u, const std::string& branch);
+
+        // lists the branches of all the given repos concurrently and caches them,
+        // blocks until they're all done; urls that are already cached are skipped
+        // and failures are left for branch_exists() to report
+        //
+        void prefetch(const std::vector<mob::url>& urls);
+
+    private:
+        using branches = std::set<std::string>;
+
+        // branch names per url; concurrent requests for the same url share the
+        // same future so ls-remote only runs once
+        std::map<std::string, std::shared_future<branches>> refs_;
+        std::mutex mutex_;
+
+        git_remote_refs() = default;
+
+        // returns the cached branches for the url, runs ls-remote if needed
+        //
+        const branches& get(const mob::url& u);
+
+        // runs `git ls-remote --heads` and returns the branch names, bails out
+        // on failure
+        //
+        static branches list_branches(const mob::url& u);
+    };
+
     // tool to handle git operations, used by tasks
     //
     class git : public basic_process_runner {
@@ -262,6 +400,21 @@ namespace mob {
         //
         git& shallow(bool b);
 
+        // if true, keeps a mirror of the repo in the cache directory and clones
+        // from it, see update_mirror()
+        //
+        git& mirror(bool b);
+
+        // partial clone filter given to `git clone --filter`, such as "blob:none";
+        // ignored when mirror() is set
+        //
+        git& filter(const std::string& spec);
+
+        // if not empty, clones with `--sparse` and only checks out the given
+        // directories, along with the files at the root
+        //
+        git& sparse(std::vector<std::string> dirs);
+
         // if set, calls git_wrap::set_origin_and_upstream_remotes()
         //
         git& remote(std::string org, std::string key, bool no_push_upstream,
@@ -283,6 +436,9 @@ namespace mob {
         std::string creds_username_;
         std::string creds_email_;
         bool shallow_;
+        bool mirror_;
+        std::string filter_;
+        std::vector<std::string> sparse_;
         std::string remote_org_;
         std::string remote_key_;
         bool no_push_upstream_;
@@ -290,38 +446,41 @@ namespace mob {
 
         bool do_clone();
         void do_pull();
+
+        // clones the mirror for url_ if it doesn't exist, or fetches it once per
+        // run; returns the mirror directory
+        //
+        fs::path update_mirror();
     };
 
-    // tool to handle git submodule operations, used by the modorganizer task to
-    // set up the submodules
+    // describes a submodule to add, used by the modorganizer task to set up the
+    // submodules
     //
-    // this tool is not normally run directly, instances of git_submodule are given
-    // to the git_submodule_adder, which runs all of them in a thread
+    // instances of git_submodule are given to the git_submodule_adder, which adds
+    // all of them at once
     //
-    class git_submodule : public basic_process_runner {
+    class git_submodule {
     public:
-        git_submodule();
-
         // remote url
         //
         git_submodule& url(const mob::url& u);
+        const mob::url& url() const;
 
         // root directory of the repo
         //
         git_submodule& root(const fs::path& dir);
+        const fs::path& root() const;
 
         // branch name
         //
         git_submodule& branch(const std::string& name);
+        const std::string& branch() const;
 
         // submodule name
         //
         git_submodule& submodule(const std::string& name);
         const std::string& submodule() const;
 
-    protected:
-        void do_run() override;
-
     private:
         mob::url url_;
         fs::path root_;
@@ -329,17 +488,20 @@ namespace mob {
         std::string submodule_;
     };
 
-    // queues submodule operations with queue(), runs them in a thread because they
-    // take a long time but can happen while stuff is building
+    // collects the submodules queued by the modorganizer tasks and adds them when
+    // stop() is called, once all the repos are cloned
+    //
+    // everything is added with a single git_wrap::add_submodules() call per super
+    // repo instead of one `git submodule add` per project
     //
     class git_submodule_adder {
     public:
-        // calls stop() and joins
+        // drops the queue without adding anything, stop() must be called
+        // explicitly
         //
         ~git_submodule_adder();
 
-        // only one instance, runs the thread and waits for submodules to be added
-        // by queue()
+        // only one instance
         //
         static git_submodule_adder& instance();
 
@@ -347,52 +509,19 @@ namespace mob {
         //
         void queue(git_submodule g);
 
-        // stops the thread
+        // adds everything in the queue
         //
         void stop();
 
     private:
-        // used to sleep until queue() is called
-        //
-        struct sleeper {
-            std::mutex m;
-            std::condition_variable cv;
-            bool ready = false;
-        };
-
         // log context
         context cx_;
 
-        // thread
-        std::thread thread_;
-
         // queue
         std::vector<git_submodule> queue_;
         mutable std::mutex queue_mutex_;
 
-        // true in stop(), stops the thread
-        std::atomic<bool> quit_;
-
-        // used to sleep until queue() is called
-        sleeper sleeper_;
-
         git_submodule_adder();
-
-        // starts the thread
-        //
-        void run();
-
-        // thread function, sleeps until queue() is called
-        //
-        void thread_fun();
-
-        // forces the thread function to wake up
-        //
-        void wakeup();
-
-        // processes the queue
-        //
-        void process();
     };
 
 }  // namespace mob
@@ -0,0 +1,266 @@
+#include "pch.h"
+#include "tools.h"
+
+#ifdef MOB_LIBGIT2
+#include <git2.h>
+#endif
+
+// read-only queries done in-process with libgit2 when mob is built with
+// -DMOB_LIBGIT2=ON, see git.h; without it, all of these return an empty
+// optional and git_wrap runs the git binary instead
+
+namespace mob::details::libgit2 {
+
+#ifdef MOB_LIBGIT2
+
+    namespace {
+
+        // libgit2 must be initialized once before being used, it's thread-safe
+        // after that; it's never shut down, the process is about to exit anyway
+        //
+        void init()
+        {
+            static std::once_flag flag;
+            std::call_once(flag, [] { git_libgit2_init(); });
+        }
+
+        // logs the last libgit2 error for the given root, the caller falls back
+        // to the git binary
+        //
+        void log_error(const fs::path& root, std::string_view what)
+        {
+            const git_error* e = git_error_last();
+
+            gcx().trace(context::generic, "libgit2: {} failed for {}, {}", what, root,
+                        (e && e->message ? e->message : "unknown error"));
+        }
+
+        // owns a libgit2 object, calls the given function on destruction
+        //
+        template <class T, void (*Free)(T*)>
+        class handle {
+        public:
+            handle() = default;
+            ~handle()
+            {
+                if (p_)
+                    Free(p_);
+            }
+
+            handle(const handle&)            = delete;
+            handle& operator=(const handle&) = delete;
+
+            T* get() const { return p_; }
+            T** out() { return &p_; }
+
+        private:
+            T* p_ = nullptr;
+        };
+
+        using repository = handle<git_repository, git_repository_free>;
+        using reference  = handle<git_reference, git_reference_free>;
+        using status     = handle<git_status_list, git_status_list_free>;
+        using remote     = handle<git_remote, git_remote_free>;
+
+        // opens the repo that contains the given directory, like running git
+        // from it would; returns 0 on success or a libgit2 error code
+        //
+        int open(repository& repo, const fs::path& root)
+        {
+            init();
+            return git_repository_open_ext(repo.out(), path_to_utf8(root).c_str(), 0,
+                                           nullptr);
+        }
+
+    }  // namespace
+
+    std::optional<bool> is_git_repo(const fs::path& root)
+    {
+        repository repo;
+        const int r = open(repo, root);
+
+        if (r == GIT_ENOTFOUND)
+            return false;
+
+        if (r != 0) {
+            log_error(root, "open");
+            return {};
+        }
+
+        // same as `rev-parse --is-inside-work-tree`
+        return !git_repository_is_bare(repo.get());
+    }
+
+    std::optional<std::string> current_branch(const fs::path& root)
+    {
+        repository repo;
+        if (open(repo, root) != 0) {
+            log_error(root, "open");
+            return {};
+        }
+
+        // `branch --show-current` outputs nothing for a detached head
+        const int detached = git_repository_head_detached(repo.get());
+        if (detached == 1)
+            return std::string();
+        else if (detached < 0) {
+            // includes unborn branches, let git handle those
+            log_error(root, "head_detached");
+            return {};
+        }
+
+        reference head;
+        if (git_repository_head(head.out(), repo.get()) != 0) {
+            log_error(root, "head");
+            return {};
+        }
+
+        return std::string(git_reference_shorthand(head.get()));
+    }
+
+    std::optional<bool> has_uncommitted_changes(const fs::path& root)
+    {
+        repository repo;
+        if (open(repo, root) != 0) {
+            log_error(root, "open");
+            return {};
+        }
+
+        // same as `status --porcelain`, which includes untracked files
+        git_status_options opts = GIT_STATUS_OPTIONS_INIT;
+        opts.show               = GIT_STATUS_SHOW_INDEX_AND_WORKDIR;
+        opts.flags              = GIT_STATUS_OPT_INCLUDE_UNTRACKED;
+
+        status list;
+        if (git_status_list_new(list.out(), repo.get(), &opts) != 0) {
+            log_error(root, "status");
+            return {};
+        }
+
+        return (git_status_list_entrycount(list.get()) > 0);
+    }
+
+    std::optional<bool> has_source_changes(const fs::path& root)
+    {
+        repository repo;
+        if (open(repo, root) != 0) {
+            log_error(root, "open");
+            return {};
+        }
+
+        // same as `status --porcelain --untracked-files=no`, .ts files are
+        // skipped below
+        git_status_options opts = GIT_STATUS_OPTIONS_INIT;
+        opts.show               = GIT_STATUS_SHOW_INDEX_AND_WORKDIR;
+        opts.flags              = 0;
+
+        status list;
+        if (git_status_list_new(list.out(), repo.get(), &opts) != 0) {
+            log_error(root, "status");
+            return {};
+        }
+
+        const std::size_t count = git_status_list_entrycount(list.get());
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const git_status_entry* e = git_status_byindex(list.get(), i);
+            if (!e)
+                continue;
+
+            const git_diff_delta* d =
+                (e->index_to_workdir ? e->index_to_workdir : e->head_to_index);
+
+            if (!d)
+                return true;
+
+            const char* path = (d->new_file.path ? d->new_file.path : d->old_file.path);
+
+            if (!path || !std::string_view(path).ends_with(".ts"))
+                return true;
+        }
+
+        return false;
+    }
+
+    std::optional<bool> has_stashed_changes(const fs::path& root)
+    {
+        repository repo;
+        if (open(repo, root) != 0) {
+            log_error(root, "open");
+            return {};
+        }
+
+        // stashes are kept in the reflog of refs/stash, which only exists when
+        // there's at least one
+        reference stash;
+        const int r = git_reference_lookup(stash.out(), repo.get(), "refs/stash");
+
+        if (r == GIT_ENOTFOUND)
+            return false;
+
+        if (r != 0) {
+            log_error(root, "stash lookup");
+            return {};
+        }
+
+        return true;
+    }
+
+    std::optional<bool> has_remote(const fs::path& root, const std::string& name)
+    {
+        repository repo;
+        if (open(repo, root) != 0) {
+            log_error(root, "open");
+            return {};
+        }
+
+        remote rm;
+        const int r = git_remote_lookup(rm.out(), repo.get(), name.c_str());
+
+        if (r == GIT_ENOTFOUND || r == GIT_EINVALIDSPEC)
+            return false;
+
+        if (r != 0) {
+            log_error(root, "remote lookup");
+            return {};
+        }
+
+        // `config remote.name.url` fails for a remote that has no url
+        return (git_remote_url(rm.get()) != nullptr);
+    }
+
+#else
+
+    std::optional<bool> is_git_repo(const fs::path&)
+    {
+        return {};
+    }
+
+    std::optional<std::string> current_branch(const fs::path&)
+    {
+        return {};
+    }
+
+    std::optional<bool> has_uncommitted_changes(const fs::path&)
+    {
+        return {};
+    }
+
+    std::optional<bool> has_source_changes(const fs::path&)
+    {
+        return {};
+    }
+
+    std::optional<bool> has_stashed_changes(const fs::path&)
+    {
+        return {};
+    }
+
+    std::optional<bool> has_remote(const fs::path&, const std::string&)
+    {
+        return {};
+    }
+
+#endif
+
+}  // namespace mob::details::libgit2
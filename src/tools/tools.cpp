@@ -280,30 +280,112 @@ namespace mob {
         execute_and_join(p);
     }
 
-    void build_loop(const context& cx, std::function<bool(bool)> f)
+    namespace {
+
+        // adds one failure for each target in the given file, which has a
+        // "count target" line per target
+        //
+        void record_flaky(const context& cx, const fs::path& file,
+                          const std::vector<std::string>& targets)
+        {
+            std::map<std::string, int> counts;
+
+            if (exists(file)) {
+                const auto text =
+                    op::read_text_file(cx, encodings::utf8, file, op::optional);
+
+                for_each_line(text, [&](auto&& line) {
+                    const auto sp = line.find(' ');
+                    if (sp == std::string_view::npos)
+                        return;
+
+                    try {
+                        counts[std::string(line.substr(sp + 1))] =
+                            std::stoi(std::string(line.substr(0, sp)));
+                    }
+                    catch (std::exception&) {
+                        // ignore bad lines
+                    }
+                });
+            }
+
+            for (auto&& t : targets) {
+                const auto n = ++counts[t];
+                cx.warning(context::generic,
+                           "{} failed but built when retried, flaky {} time(s) so "
+                           "far, see {}",
+                           t, n, file);
+            }
+
+            std::string text;
+            for (auto&& [t, n] : counts)
+                text += std::format("{} {}\n", n, t);
+
+            op::create_directories(cx, file.parent_path());
+            op::write_text_file(cx, encodings::utf8, file, text);
+        }
+
+    }  // namespace
+
+    void build_loop(
+        const context& cx, int jobs, const fs::path& flaky_file,
+        std::function<build_result(int jobs, const std::vector<std::string>& targets)>
+            f)
     {
-        // building sometimes fails with files being locked
         const int max_tries = 3;
 
-        for (int tries = 0; tries < max_tries; ++tries) {
-            // try a multiprocess build
-            if (f(true)) {
-                // building succeeded, done
-                return;
+        auto r = f(jobs, {});
+
+        for (int tries = 1; !r.succeeded && tries <= max_tries; ++tries) {
+            // races are less likely with fewer jobs
+            const int retry_jobs = std::max(1, jobs >> tries);
+
+            if (r.failed.empty()) {
+                cx.debug(context::generic,
+                         "can't tell which targets failed, building everything "
+                         "again with {} jobs",
+                         retry_jobs);
+
+                r = f(retry_jobs, {});
+                continue;
             }
 
-            cx.debug(context::generic,
-                     "multiprocess build sometimes fails because of race "
-                     "conditions; trying again");
+            const auto targets = r.failed;
+
+            cx.debug(context::generic, "building {} again with {} jobs",
+                     join(targets, ", "), retry_jobs);
+
+            r = f(retry_jobs, targets);
+
+            if (!r.succeeded) {
+                // some build tools don't report a target that didn't even start
+                if (r.failed.empty())
+                    r.failed = targets;
+
+                continue;
+            }
+
+            // they built fine by themselves, they didn't have actual errors
+            record_flaky(cx, flaky_file, targets);
+
+            // the first build stopped at the failures, build the rest
+            r = f(jobs, {});
         }
 
-        cx.debug(context::generic,
-                 "multiprocess build has failed more than {} times, "
-                 "restarting one last time single process; that one should work",
-                 max_tries);
+        if (!r.succeeded) {
+            cx.debug(context::generic,
+                     "build has failed more than {} times, restarting one last "
+                     "time single process; that one should work",
+                     max_tries);
+
+            // do one last single process build, everything, in case the
+            // failures stopped targets that were never reported
+            r = f(1, {});
+        }
 
-        // do one last single process build
-        f(false);
+        if (!r.succeeded)
+            cx.bail_out(context::generic, "build failed after {} tries",
+                        max_tries + 1);
     }
 
 }  // namespace mob
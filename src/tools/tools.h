@@ -283,7 +283,9 @@ namespace mob {
     // if extraction fails, an interruption file is left in the directory so
     // extraction is restarted next time mob runs
     //
-    // 7z is bundled with mob in third-party/bin
+    // .tar, .tar.gz, .tgz and .zip archives are extracted in-process with zlib,
+    // everything else goes through 7z, which is bundled with mob in
+    // third-party/bin
     //
     class extractor : public basic_process_runner {
     public:
@@ -310,10 +312,38 @@ namespace mob {
         fs::path file_;
         fs::path where_;
 
+        // extracts the archive by running 7z
+        //
+        void extract_with_7z(const fs::path& ifile);
+
         // some archives have a top level directory, this moves all the files up one
         // directory and deletes the now empty top level directory
         //
+        // only used for archives extracted by 7z, the native extractors below
+        // strip the directory while extracting
+        //
         void check_for_top_level_directory(const fs::path& ifile);
+
+        // whether file_ is a .tar, .tar.gz or .tgz
+        //
+        bool is_tar() const;
+
+        // whether file_ is a .zip
+        //
+        bool is_zip() const;
+
+        // extracts a .tar or .tar.gz archive, decompressing it with zlib; small
+        // files are written in batches on multiple threads
+        //
+        void extract_tar();
+
+        // extracts a .zip archive on multiple threads
+        //
+        // returns false without touching the output directory if the archive uses
+        // something that isn't supported, like encryption or compression methods
+        // other than deflate, in which case 7z should be used instead
+        //
+        bool extract_zip();
     };
 
     // tool to handle creating archives, 7z is bundled with mob in third-party/bin
@@ -321,6 +351,9 @@ namespace mob {
     // this isn't used by any task, but it's used in a few places in op.cpp, mostly
     // for creating archives with the `release` command
     //
+    // `c` is the compression profile and `threads` is given to 7z with -mmt, 0
+    // lets 7z use all the cores
+    //
     class archiver : public basic_process_runner {
     public:
         // archives all the files matching `glob` into a file `out`, ignoring
@@ -328,13 +361,23 @@ namespace mob {
         //
         static void create_from_glob(const context& cx, const fs::path& out,
                                      const fs::path& glob,
-                                     const std::vector<std::string>& ignore);
+                                     const std::vector<std::string>& ignore,
+                                     compression c       = compression::normal,
+                                     std::size_t threads = 0);
 
         // archives all the given files rooted in `files_root`, into a file `out`
         //
         static void create_from_files(const context& cx, const fs::path& out,
                                       const std::vector<fs::path>& files,
-                                      const fs::path& files_root);
+                                      const fs::path& files_root,
+                                      compression c       = compression::normal,
+                                      std::size_t threads = 0);
+
+    private:
+        // adds the 7z switches for the given compression profile and thread count
+        //
+        static void add_compression_args(process& p, compression c,
+                                         std::size_t threads);
     };
 
     // tool that runs transifex, used for pulling translations before release,
@@ -495,21 +538,36 @@ namespace mob {
         fs::path out_;
     };
 
-    // some tasks use a multiprocess version of their build tool to make things
-    // faster, but the build process might fail because the projects are not really
-    // set up correctly for multiprocess (locked files, etc.)
+    // returned by the function given to build_loop()
+    //
+    struct build_result {
+        bool succeeded = false;
+
+        // targets that failed, as given by the build tool; empty if the build
+        // succeeded or if the failures couldn't be parsed
+        std::vector<std::string> failed;
+    };
+
+    // parallel builds sometimes fail because the projects are not really set up
+    // correctly for them (locked files, races between custom commands, etc.),
+    // but building everything again is expensive for large projects
     //
-    // that's the case for nmm, openssl and couple of others
+    // `f` is called with `jobs` and no targets first, which should build
+    // everything; when it fails, only the targets that failed are built again
+    // with fewer and fewer jobs, then everything is built once more to finish
+    // the parts that were stopped by the failure
     //
-    // so `f` will first be called in a loop a couple of times with its parameter as
-    // `true`; it should run the build multiprocess and return whether the build
-    // succeeded, which will end the loop and return immediately
+    // if that still fails, everything is built one last time as a single
+    // process, which works around races that fewer jobs didn't avoid
     //
-    // if `f` returned false every time in the loop, it will be called one last time
-    // with its parameter as `false`, which should build one final time with any
-    // multiprocess flags
+    // targets that built fine when retried are flaky and are counted in
+    // `flaky_file`, which is kept across runs so recurring offenders are easy
+    // to find; bails out if the single process build fails too
     //
-    void build_loop(const context& cx, std::function<bool(bool)> f);
+    void build_loop(
+        const context& cx, int jobs, const fs::path& flaky_file,
+        std::function<build_result(int jobs, const std::vector<std::string>& targets)>
+            f);
 
 }  // namespace mob
 
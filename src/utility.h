@@ -48,6 +48,10 @@ namespace mob {
 
     enum class config { debug, relwithdebinfo, release };
 
+    // compression profiles for archives created by mob, see archiver
+    //
+    enum class compression { store, fast, normal, max };
+
     class url;
 
     // returns "mob x.y"
@@ -4,9 +4,158 @@
 #include "../core/context.h"
 #include "../core/op.h"
 #include "../utility.h"
+#include <condition_variable>
+#include <deque>
 
 namespace mob {
 
+    namespace {
+
+        // walks a single directory for walk_directory(), adds files to `files`
+        // and directories that should be walked to `dirs`; bails out on errors,
+        // a partial list would silently leave files out of releases and copies
+        //
+        void walk_one_directory(
+            const context& cx, const fs::path& dir,
+            const std::function<bool(const fs::directory_entry&)>& skip,
+            std::vector<walked_file>& files, std::vector<fs::path>& dirs)
+        {
+            std::error_code ec;
+            fs::directory_iterator itor(dir, ec);
+
+            if (ec)
+                cx.bail_out(context::fs, "can't walk {}, {}", dir, ec.message());
+
+            for (; itor != fs::directory_iterator(); itor.increment(ec)) {
+                if (ec) {
+                    cx.bail_out(context::fs, "error while walking {}, {}", dir,
+                                ec.message());
+                }
+
+                const auto& e = *itor;
+
+                if (skip(e))
+                    continue;
+
+                if (e.is_directory(ec)) {
+                    dirs.push_back(e.path());
+                }
+                else if (e.is_regular_file(ec)) {
+                    const auto size = e.file_size(ec);
+
+                    if (ec) {
+                        cx.bail_out(context::fs, "can't get size of {}, {}",
+                                    e.path(), ec.message());
+                    }
+
+                    const auto time = e.last_write_time(ec);
+
+                    if (ec) {
+                        cx.bail_out(context::fs, "can't get time of {}, {}",
+                                    e.path(), ec.message());
+                    }
+
+                    files.push_back({e.path(), size, time});
+                }
+            }
+        }
+
+    }  // namespace
+
+    std::vector<walked_file>
+    walk_directory(const context& cx, const fs::path& root,
+                   const std::function<bool(const fs::directory_entry&)>& skip,
+                   std::optional<std::size_t> threads)
+    {
+        const std::size_t count = std::max<std::size_t>(
+            1, threads.value_or(std::thread::hardware_concurrency()));
+
+        // directories waiting to be walked, shared by all threads
+        std::mutex m;
+        std::condition_variable cv;
+        std::deque<fs::path> queue = {root};
+
+        // number of directories currently being walked; when it's 0 and the
+        // queue is empty, everything's been walked
+        std::size_t busy = 0;
+
+        // first exception thrown by `skip` or walk_one_directory(), stops
+        // everything
+        std::exception_ptr error;
+
+        // each thread has its own list, merged at the end
+        std::vector<std::vector<walked_file>> results(count);
+
+        auto worker = [&](std::size_t i) {
+            for (;;) {
+                fs::path dir;
+
+                {
+                    std::unique_lock lock(m);
+
+                    cv.wait(lock, [&] {
+                        return !queue.empty() || busy == 0 || error;
+                    });
+
+                    if (queue.empty() || error)
+                        return;
+
+                    dir = std::move(queue.front());
+                    queue.pop_front();
+                    ++busy;
+                }
+
+                std::vector<fs::path> dirs;
+
+                try {
+                    walk_one_directory(cx, dir, skip, results[i], dirs);
+                }
+                catch (...) {
+                    std::scoped_lock lock(m);
+
+                    if (!error)
+                        error = std::current_exception();
+                }
+
+                {
+                    std::scoped_lock lock(m);
+
+                    for (auto&& d : dirs)
+                        queue.push_back(std::move(d));
+
+                    --busy;
+                }
+
+                cv.notify_all();
+            }
+        };
+
+        std::vector<std::thread> ts;
+        for (std::size_t i = 0; i < count; ++i)
+            ts.push_back(start_thread([&, i] {
+                worker(i);
+            }));
+
+        for (auto&& t : ts)
+            t.join();
+
+        if (error)
+            std::rethrow_exception(error);
+
+        std::vector<walked_file> files;
+
+        for (auto&& r : results)
+            files.insert(files.end(), std::make_move_iterator(r.begin()),
+                         std::make_move_iterator(r.end()));
+
+        // threads finish in any order, keep the output stable
+        std::sort(files.begin(), files.end(), [](auto&& a, auto&& b) {
+            return a.path < b.path;
+        });
+
+        return files;
+    }
+
     file_deleter::file_deleter(const context& cx, fs::path p)
         : cx_(cx), p_(std::move(p)), delete_(true)
     {
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <filesystem>
+#include <functional>
+#include <optional>
 
 #ifdef __unix__
 #include "../linux_compatibility.h"
@@ -42,6 +44,38 @@ namespace mob {
 
     using file_ptr = std::unique_ptr<FILE, file_closer>;
 
+    // asks the filesystem to reserve `size` bytes for the given file so large
+    // writes don't fragment it; this is only a hint, errors are ignored
+    //
+    void preallocate_file(std::FILE* f, std::uintmax_t size);
+
+    // a regular file found by walk_directory()
+    //
+    struct walked_file {
+        fs::path path;
+        std::uintmax_t size = 0;
+        fs::file_time_type time;
+    };
+
+    // recursively walks `root` and returns all the regular files in it, sorted
+    // by path
+    //
+    // every directory is a separate work item picked up by one of `threads`
+    // threads (defaults to the number of cores), so large trees are walked
+    // concurrently; sizes and times come from the fs::directory_entry, which
+    // already has them on windows and needs a stat for each on linux
+    //
+    // `skip` is called for every entry, possibly concurrently; entries for which
+    // it returns true are ignored and directories are not walked
+    //
+    // errors while reading a directory bail out; the first exception, from
+    // either an error or `skip`, is rethrown once all the threads are stopped
+    //
+    std::vector<walked_file> walk_directory(
+        const context& cx, const fs::path& root,
+        const std::function<bool(const fs::directory_entry&)>& skip,
+        std::optional<std::size_t> threads = {});
+
     // deletes the given file in the destructor unless cancel() is called
     //
     class file_deleter {
@@ -30,4 +30,14 @@ namespace mob {
         return std::filesystem::path(filename);
     }
 
+    void preallocate_file(std::FILE* f, std::uintmax_t size)
+    {
+        if (!f || size == 0)
+            return;
+
+        // returns an error code instead of setting errno, but it's only a hint
+        // anyway
+        posix_fallocate(fileno(f), 0, static_cast<off_t>(size));
+    }
+
 }  // namespace mob
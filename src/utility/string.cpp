@@ -152,6 +152,18 @@ namespace mob {
         return s;
     }
 
+    std::string hash_string(std::string_view s)
+    {
+        std::uint64_t h = 0xcbf29ce484222325ull;
+
+        for (const char c : s) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 0x100000001b3ull;
+        }
+
+        return std::format("{:016x}", h);
+    }
+
     std::string table(const std::vector<std::pair<std::string, std::string>>& v,
                       std::size_t indent, std::size_t spacing)
     {
@@ -67,6 +67,12 @@ namespace mob {
     std::string trim_copy(std::string_view s, std::string_view what = " \t\r\n");
     std::wstring trim_copy(std::wstring_view s, std::wstring_view what = L" \t\r\n");
 
+    // returns a 64-bit FNV-1a hash of the given bytes as 16 hex characters; the
+    // result is the same on every run and platform, so it can be saved to disk
+    // to detect changes, but it's not meant for anything security related
+    //
+    std::string hash_string(std::string_view s);
+
     // formats a vector of pairs into two columns, putting `indent` spaces at the
     // start of each line and `spacing` spaces between the columns
     //
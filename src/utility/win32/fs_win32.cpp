@@ -20,4 +20,20 @@ namespace mob {
         return dir / name;
     }
 
+    void preallocate_file(std::FILE* f, std::uintmax_t size)
+    {
+        if (!f || size == 0)
+            return;
+
+        const auto h = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(f)));
+        if (h == INVALID_HANDLE_VALUE)
+            return;
+
+        FILE_ALLOCATION_INFO info = {};
+        info.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+
+        // only a hint, failures are ignored
+        ::SetFileInformationByHandle(h, FileAllocationInfo, &info, sizeof(info));
+    }
+
 }  // namespace mob